@@ -2,12 +2,14 @@
 #include "sessionstreamcontroller.hpp"
 
 constexpr float kMaxLossRate = 0.20;
+constexpr uint32_t kMaxIntervals = 64;/** capacity of the interval history ring of TestCongestionCtrl*/
 constexpr float probe_gain[] = {
     1.0 / 2, 1.0 / 1.5, 1.0 / 1.25, 1.0 / 1.1, 1.0 / 1.05, 1.0 / 1.02,
     1.02, 1.05, 1.1, 1.25, //1.5, 2
 };
 
 TestCongestionCtrl::TestCongestionCtrl(const TestCongestionCtlConfig& ccConfig)
+        : m_intervals(kMaxIntervals)
 {
     m_id = rand();
     SPDLOG_DEBUG("ccid:{}", m_id);
@@ -31,9 +33,14 @@ void TestCongestionCtrl::OnDataSent(const InflightPacket& sentpkt)
     if (MaybeCreateInterval()) {
         CreateInterval();
     }
+    Interval& newest = NewestInterval();
+    if (newest.first_sent_seq == MAX_SEQNUMBER) {
+        newest.first_sent_seq = sentpkt.seq;
+    }
+    m_seqToInterval.Insert(sentpkt.seq, m_nextInterval - 1);
     // update sent interval history
-    if (!m_intervalHistory.back().sent_done) {
-        m_intervalHistory.back().OnDataSent(sentpkt);
+    if (!newest.sent_done) {
+        newest.OnDataSent(sentpkt);
     }
 }
 
@@ -57,54 +64,68 @@ void TestCongestionCtrl::OnDataLoss(const LossEvent& lossEvent)
 {
     QuicTime now = Clock::GetClock()->Now();
     uint32_t maxLossSeq = 0;
-    for (auto& itvl : m_intervalHistory)
+    for (auto &pkt : lossEvent.lossPackets)
     {
-        for (auto &pkt : lossEvent.lossPackets)
+        maxLossSeq = std::max(maxLossSeq, pkt.seq);
+        // keep the seq mapped, a late arrival of the packet moves it back from loss_cnt to ack_cnt
+        Interval* itvl = IntervalOfSeq(pkt.seq);
+        if (itvl)
         {
-            maxLossSeq = std::max(maxLossSeq, pkt.seq);
-            if (pkt.seq >= itvl.start_seq && pkt.seq <= itvl.end_seq)
+            if (!itvl->first_recv_tic.IsInitialized()) {
+                itvl->first_recv_tic = Clock::GetClock()->Now();
+            }
+            ++itvl->loss_cnt;
+            if (itvl->send_cnt == itvl->loss_cnt + itvl->ack_cnt)
             {
-                if (!itvl.first_recv_tic.IsInitialized()) {
-                    itvl.first_recv_tic = Clock::GetClock()->Now();
-                }
-                ++itvl.loss_cnt;
-                if (itvl.send_cnt == itvl.loss_cnt + itvl.ack_cnt)
-                {
-                    itvl.recv_done = true;
-                    itvl.CalculateStatistics();
-                }
+                itvl->recv_done = true;
+                itvl->CalculateStatistics();
             }
         }
     }
-    m_intervalHistory.back().CheckIfSentDone(maxLossSeq, now);
+    NewestInterval().CheckIfSentDone(maxLossSeq, now);
 }
 
 void TestCongestionCtrl::OnDataRecv(const AckEvent& ackEvent)
 {
     QuicTime now = Clock::GetClock()->Now();
-    for (auto& itvl : m_intervalHistory)
+    Interval* itvl = IntervalOfSeq(ackEvent.ackPacket.seq);
+    if (itvl)
     {
-        if (ackEvent.ackPacket.seq >= itvl.start_seq && ackEvent.ackPacket.seq <= itvl.end_seq)
+        if (!itvl->first_recv_tic.IsInitialized()) {
+            itvl->first_recv_tic = Clock::GetClock()->Now();
+        }
+        ++itvl->ack_cnt;
+        if (itvl->send_cnt == itvl->loss_cnt + itvl->ack_cnt)
         {
-            if (!itvl.first_recv_tic.IsInitialized()) {
-                itvl.first_recv_tic = Clock::GetClock()->Now();
-            }
-            ++itvl.ack_cnt;
-            itvl.ackTimeInMs.insert(now.ToDebuggingValue() / 1000);
-            if (itvl.send_cnt == itvl.loss_cnt + itvl.ack_cnt)
-            {
-                itvl.recv_done = true;
-                itvl.CalculateStatistics();
-            }
+            itvl->recv_done = true;
+            itvl->CalculateStatistics();
+        }
+    }
+    m_seqToInterval.Erase(ackEvent.ackPacket.seq);
+    NewestInterval().CheckIfSentDone(ackEvent.ackPacket.seq, now);
+}
+
+void TestCongestionCtrl::OnSpuriousLoss(const InflightPacket& lostpkt)
+{
+    // count the packet as acked in the interval that counted it as lost, so the next decision sees no loss
+    Interval* itvl = IntervalOfSeq(lostpkt.seq);
+    if (itvl && itvl->loss_cnt > 0)
+    {
+        --itvl->loss_cnt;
+        ++itvl->ack_cnt;
+        if (itvl->recv_done)
+        {
+            itvl->loss_rate = (float)itvl->loss_cnt / itvl->send_cnt;
         }
+        SPDLOG_DEBUG("ccid:{} spurious loss seq:{} interval:{}", m_id, lostpkt.seq, itvl->ToStr());
     }
-    m_intervalHistory.back().CheckIfSentDone(ackEvent.ackPacket.seq, now);
+    m_seqToInterval.Erase(lostpkt.seq);
 }
 
 uint32_t TestCongestionCtrl::GetCWND()
 {
-    if (!m_intervalHistory.empty()) {
-        return m_intervalHistory.back().target_cwnd;
+    if (m_nextInterval != m_oldestInterval) {
+        return NewestInterval().target_cwnd;
     } else {
         return m_initCwnd;
     }
@@ -117,37 +138,93 @@ bool TestCongestionCtrl::IsSeqValid(uint32_t seq)
 
 bool TestCongestionCtrl::MaybeCreateInterval()
 {
-    return m_intervalHistory.empty() || m_intervalHistory.back().sent_done;
+    return m_nextInterval == m_oldestInterval || NewestInterval().sent_done;
+}
+
+bool TestCongestionCtrl::HasInterval(uint64_t serial) const
+{
+    return serial >= m_oldestInterval && serial < m_nextInterval;
+}
+
+Interval& TestCongestionCtrl::IntervalAt(uint64_t serial)
+{
+    return m_intervals[serial % m_intervals.size()];
+}
+
+Interval& TestCongestionCtrl::NewestInterval()
+{
+    return IntervalAt(m_nextInterval - 1);
+}
+
+Interval* TestCongestionCtrl::IntervalOfSeq(uint32_t seq)
+{
+    const uint64_t* serial = m_seqToInterval.Find(seq);
+    if (!serial || !HasInterval(*serial))
+    {
+        return nullptr;
+    }
+    Interval& itvl = IntervalAt(*serial);
+    if (seq < itvl.start_seq || seq > itvl.end_seq)
+    {
+        // sent above the target cwnd of the interval and not covered by its range
+        return nullptr;
+    }
+    return &itvl;
+}
+
+void TestCongestionCtrl::PushInterval(const Interval& itvl)
+{
+    if (m_nextInterval - m_oldestInterval == m_intervals.size())
+    {
+        SPDLOG_DEBUG("ccid:{} interval history full, drop:{}", m_id, IntervalAt(m_oldestInterval).ToStr());
+        DropIntervalsBefore(m_oldestInterval + 1);
+    }
+    IntervalAt(m_nextInterval) = itvl;
+    if (itvl.probe_gain != 1.0)
+    {
+        m_probeInterval = m_nextInterval;
+        m_hasProbe = true;
+    }
+    ++m_nextInterval;
+}
+
+void TestCongestionCtrl::DropIntervalsBefore(uint64_t serial)
+{
+    m_oldestInterval = std::max(m_oldestInterval, std::min(serial, m_nextInterval));
+    // seqs are sent in order, so every seq sent before the oldest kept interval belongs to a dropped one
+    uint32_t keepSeq = HasInterval(m_oldestInterval) ? IntervalAt(m_oldestInterval).first_sent_seq : MAX_SEQNUMBER;
+    while (!m_seqToInterval.empty() && m_seqToInterval.BaseSeq() < keepSeq)
+    {
+        m_seqToInterval.Erase(m_seqToInterval.BaseSeq());
+    }
 }
 
 void TestCongestionCtrl::CreateInterval()
 {
     Interval itvl;
-    if (m_intervalHistory.empty())
+    if (m_nextInterval == m_oldestInterval)
     {   // initial state
         itvl.target_cwnd = m_initCwnd;
         itvl.base_cwnd = m_initCwnd;
         itvl.probe_gain = 1.0;
     } else
     {   // find the probe interval
-        int probe_index = m_intervalHistory.size() - 1;
-        for ( ; probe_index >= 0; probe_index--)
-        {
-            if (m_intervalHistory[probe_index].probe_gain != 1.0)
-            {
-                break;
-            }
-        }
-        if (probe_index == -1)
+        if (!m_hasProbe)
         { // create probe interval if no probe interval found
             itvl.target_cwnd = m_initCwnd * 2;
             itvl.base_cwnd = m_initCwnd;
             itvl.probe_gain = 2.0;
         }
+        else if (!HasInterval(m_probeInterval) || !HasInterval(m_probeInterval - 1))
+        { // the probe never completed and has been dropped from the ring, probe again from the newest base
+            itvl.base_cwnd = NewestInterval().base_cwnd;
+            itvl.probe_gain = GetHigherProbeGain(1.0);
+            itvl.target_cwnd = itvl.base_cwnd + (int)std::max(1.0f, itvl.base_cwnd * (itvl.probe_gain - 1));
+        }
         else
         { // probe interval found
-            Interval& probe_interval = m_intervalHistory[probe_index];
-            Interval& base_interval = m_intervalHistory[probe_index - 1];
+            Interval& probe_interval = IntervalAt(m_probeInterval);
+            Interval& base_interval = IntervalAt(m_probeInterval - 1);
             if (probe_interval.recv_done && base_interval.recv_done)
             { // make decision, first make new base interval then probe interval
                 SPDLOG_DEBUG("ccid:{} base_interval:{} probe_interval:{}", m_id, base_interval.ToStr(), probe_interval.ToStr());
@@ -157,8 +234,8 @@ void TestCongestionCtrl::CreateInterval()
                 {
                     itvl.base_cwnd = std::min(probe_interval.max_inflight, base_interval.max_inflight) + 1;
                 }
-                if (m_intervalHistory.back().target_cwnd != itvl.base_cwnd
-                    || m_intervalHistory.back().probe_gain != 1.0)
+                if (NewestInterval().target_cwnd != itvl.base_cwnd
+                    || NewestInterval().probe_gain != 1.0)
                 { // create a new base interval
                     itvl.target_cwnd = itvl.base_cwnd;
                     itvl.probe_gain = 1.0;
@@ -214,7 +291,7 @@ void TestCongestionCtrl::CreateInterval()
                     }
                     itvl.target_cwnd = itvl.base_cwnd + (int)delta_cwnd;
                     // erase history
-                    m_intervalHistory.erase(m_intervalHistory.begin(), m_intervalHistory.begin() + probe_index + 1);
+                    DropIntervalsBefore(m_probeInterval + 1);
                 }
             }
             else
@@ -228,7 +305,7 @@ void TestCongestionCtrl::CreateInterval()
     itvl.base_cwnd = std::max(m_minCwnd, itvl.base_cwnd);
     itvl.target_cwnd = std::max(m_minCwnd, itvl.target_cwnd);
     SPDLOG_DEBUG("ccid:{} create new interval:{}", m_id, itvl.ToStr());
-    m_intervalHistory.push_back(itvl);    
+    PushInterval(itvl);
 }
 
 float TestCongestionCtrl::GetHigherProbeGain(float gain)
@@ -312,3 +389,976 @@ void Interval::CheckIfSentDone(uint32_t seq, QuicTime now)
         }
     }
 }
+
+/// BBR gains, draft-cardwell-iccrg-bbr-congestion-control-00 Section 4
+constexpr double kBBRHighGain = 2.885;/** 2/ln(2), doubles the sending rate every round in Startup*/
+constexpr double kBBRDrainGain = 1.0 / 2.885;
+constexpr double kBBRPacingGainCycle[] = { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+constexpr uint32_t kBBRGainCycleLen = sizeof(kBBRPacingGainCycle) / sizeof(kBBRPacingGainCycle[0]);
+constexpr uint64_t kBBRBtlBwFilterLen = 10;/** rounds*/
+constexpr double kBBRFullBwThresh = 1.25;
+constexpr uint32_t kBBRFullBwCnt = 3;
+constexpr uint32_t kBBRProbeRttCwnd = 4;
+
+BBRCongestionCtrl::BBRCongestionCtrl(const RenoCongestionCtlConfig& wndConfig, const BBRCongestionCtlConfig& ccConfig)
+        : m_maxBwFilter(kBBRBtlBwFilterLen, 0, 0)
+{
+    m_minCwnd = std::max(wndConfig.minCwnd, kBBRProbeRttCwnd);
+    m_maxCwnd = std::max(wndConfig.maxCwnd, m_minCwnd);
+    m_initCwnd = std::max(m_minCwnd, std::min(ccConfig.initCwnd, m_maxCwnd));
+    m_probeBwCwndGain = ccConfig.cwndGain;
+    m_minRttWindow = Duration::FromMilliseconds(ccConfig.minRttWindowMs);
+    m_probeRttDuration = Duration::FromMilliseconds(ccConfig.probeRttDurationMs);
+    m_cwnd = m_initCwnd;
+    m_id = rand();
+    EnterMode(Mode::startup, Clock::GetClock()->Now());
+    SPDLOG_DEBUG("ccid:{} m_minCwnd:{}, m_maxCwnd:{}, m_initCwnd:{}", m_id, m_minCwnd, m_maxCwnd, m_initCwnd);
+}
+
+BBRCongestionCtrl::~BBRCongestionCtrl()
+{
+    SPDLOG_DEBUG("ccid:{}", m_id);
+}
+
+CongestionCtlType BBRCongestionCtrl::GetCCtype()
+{
+    return CongestionCtlType::bbr;
+}
+
+void BBRCongestionCtrl::OnDataSent(const InflightPacket& sentpkt)
+{
+    // the session sampler has taken the delivery state snapshot
+}
+
+void BBRCongestionCtrl::OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats)
+{
+    Timepoint now = Clock::GetClock()->Now();
+    m_roundStart = false;
+    m_minRttExpired = false;
+    if (lossEvent.valid)
+    {
+        OnDataLoss(lossEvent);
+    }
+    uint32_t ackedCnt = 0;
+    if (ackEvent.valid && m_rateSampler && m_rateSampler->LatestSample().valid &&
+        m_rateSampler->LatestSample().seq == ackEvent.ackPacket.seq)
+    {
+        OnDataRecv(m_rateSampler->LatestSample(), now, rttstats);
+        ackedCnt = 1;
+    }
+
+    CheckFullPipe();
+    CheckDrain();
+    UpdateGainCycle(now, lossEvent.valid);
+    CheckProbeRtt(now);
+    UpdateCwnd(ackedCnt);
+    UpdatePacingRate(rttstats);
+    DEMO_TRACE_CC(TraceEvent::ccAck, ackEvent.ackPacket.seq, ackEvent.ackPacket.pieceId, now.ToDebuggingValue(),
+            ackEvent.sendtic.ToDebuggingValue(), m_cwnd, InflightCnt());
+}
+
+void BBRCongestionCtrl::OnDataRecv(const RateSample& sample, Timepoint now, RttStats& rttstats)
+{
+    if (sample.priorDelivered >= m_nextRoundDelivered)
+    {
+        m_nextRoundDelivered = Delivered();
+        ++m_roundCnt;
+        m_roundStart = true;
+    }
+
+    UpdateMinRtt(rttstats.latest_rtt(), now);
+
+    if (sample.interval <= Duration::Zero() || (!m_minRtt.IsInfinite() && sample.interval < m_minRtt))
+    {
+        // shorter than a round trip, can't tell the bottleneck rate
+        return;
+    }
+    if (sample.appLimited && sample.deliveryRate < MaxBw())
+    {
+        // the session had nothing to request, the path may well be faster
+        return;
+    }
+    m_maxBwFilter.Update(sample.deliveryRate, m_roundCnt);
+    SPDLOG_TRACE("ccid:{} seq:{} delivery rate:{} max bw:{}", m_id, sample.seq, sample.deliveryRate, MaxBw());
+}
+
+void BBRCongestionCtrl::OnDataLoss(const LossEvent& lossEvent)
+{
+    // lost requests are out of flight, but don't reduce the model: loss is not a congestion signal here
+    for (const auto& lostpkt: lossEvent.lossPackets)
+    {
+        DEMO_TRACE_CC(TraceEvent::ccLoss, lostpkt.seq, lostpkt.pieceId, lossEvent.losttic.ToDebuggingValue(),
+                lostpkt.sendtic.ToDebuggingValue(), m_cwnd, InflightCnt());
+    }
+}
+
+uint64_t BBRCongestionCtrl::Delivered() const
+{
+    return m_rateSampler ? m_rateSampler->GetDelivered() : 0;
+}
+
+size_t BBRCongestionCtrl::InflightCnt() const
+{
+    return m_rateSampler ? m_rateSampler->GetTrackedCnt() : 0;
+}
+
+void BBRCongestionCtrl::UpdateMinRtt(Duration rtt, Timepoint now)
+{
+    if (rtt <= Duration::Zero())
+    {
+        return;
+    }
+    // kept for CheckProbeRtt, the expired estimate is replaced right below
+    m_minRttExpired = m_minRttTic.IsInitialized() && now > m_minRttTic + m_minRttWindow;
+    if (rtt <= m_minRtt || m_minRttExpired)
+    {
+        m_minRtt = rtt;
+        m_minRttTic = now;
+    }
+}
+
+void BBRCongestionCtrl::CheckFullPipe()
+{
+    if (m_filledPipe || !m_roundStart)
+    {
+        return;
+    }
+    // the pipe is full once the bandwidth stops growing by 25% for 3 rounds
+    if (MaxBw() >= m_fullBw * kBBRFullBwThresh)
+    {
+        m_fullBw = MaxBw();
+        m_fullBwCnt = 0;
+        return;
+    }
+    if (++m_fullBwCnt >= kBBRFullBwCnt)
+    {
+        m_filledPipe = true;
+        SPDLOG_DEBUG("ccid:{} filled pipe, bw:{}", m_id, m_fullBw);
+    }
+}
+
+void BBRCongestionCtrl::CheckDrain()
+{
+    Timepoint now = Clock::GetClock()->Now();
+    if (m_mode == Mode::startup && m_filledPipe)
+    {
+        EnterMode(Mode::drain, now);
+    }
+    if (m_mode == Mode::drain && InflightCnt() <= InflightTarget(1.0))
+    {
+        // the queue built in startup has drained
+        EnterMode(Mode::probeBw, now);
+    }
+}
+
+void BBRCongestionCtrl::UpdateGainCycle(Timepoint now, bool hadLoss)
+{
+    if (m_mode != Mode::probeBw || m_minRtt.IsInfinite())
+    {
+        return;
+    }
+    bool isFullLength = now - m_cycleTic > m_minRtt;
+    bool advance = isFullLength;
+    if (m_pacingGain > 1.0)
+    {
+        // probe until the extra inflight is out, or loss says the pipe is full
+        advance = isFullLength && (hadLoss || InflightCnt() >= InflightTarget(m_pacingGain));
+    }
+    else if (m_pacingGain < 1.0)
+    {
+        // drain what the probe queued, early if it is gone already
+        advance = isFullLength || InflightCnt() <= InflightTarget(1.0);
+    }
+    if (advance)
+    {
+        m_cycleIndex = (m_cycleIndex + 1) % kBBRGainCycleLen;
+        m_cycleTic = now;
+        m_pacingGain = kBBRPacingGainCycle[m_cycleIndex];
+    }
+}
+
+void BBRCongestionCtrl::CheckProbeRtt(Timepoint now)
+{
+    bool expired = m_minRttExpired || (m_minRttTic.IsInitialized() && now > m_minRttTic + m_minRttWindow);
+    if (m_mode != Mode::probeRtt && expired)
+    {
+        // min RTT not refreshed for a whole window, drain the queue to measure it again
+        m_priorCwnd = m_cwnd;
+        m_probeRttDoneTic = Timepoint::Zero();
+        EnterMode(Mode::probeRtt, now);
+    }
+    if (m_mode != Mode::probeRtt)
+    {
+        return;
+    }
+    if (!m_probeRttDoneTic.IsInitialized() && InflightCnt() <= kBBRProbeRttCwnd)
+    {
+        m_probeRttDoneTic = now + m_probeRttDuration;
+        m_probeRttRoundDone = false;
+        m_nextRoundDelivered = Delivered();
+    }
+    else if (m_probeRttDoneTic.IsInitialized())
+    {
+        if (m_roundStart)
+        {
+            m_probeRttRoundDone = true;
+        }
+        if (m_probeRttRoundDone && now > m_probeRttDoneTic)
+        {
+            m_minRttTic = now;
+            m_cwnd = BoundCwnd(std::max(m_cwnd, m_priorCwnd));
+            EnterMode(m_filledPipe ? Mode::probeBw : Mode::startup, now);
+        }
+    }
+}
+
+void BBRCongestionCtrl::EnterMode(Mode mode, Timepoint now)
+{
+    m_mode = mode;
+    switch (mode)
+    {
+        case Mode::startup:
+            m_pacingGain = kBBRHighGain;
+            m_cwndGain = kBBRHighGain;
+            break;
+        case Mode::drain:
+            m_pacingGain = kBBRDrainGain;
+            m_cwndGain = kBBRHighGain;
+            break;
+        case Mode::probeBw:
+            // start at a random phase other than the draining one
+            m_cycleIndex = rand() % (kBBRGainCycleLen - 1);
+            if (m_cycleIndex >= 1)
+            {
+                ++m_cycleIndex;
+            }
+            m_cycleTic = now;
+            m_pacingGain = kBBRPacingGainCycle[m_cycleIndex];
+            m_cwndGain = m_probeBwCwndGain;
+            break;
+        case Mode::probeRtt:
+            m_pacingGain = 1.0;
+            m_cwndGain = 1.0;
+            break;
+    }
+    SPDLOG_DEBUG("ccid:{} enter {}, max bw:{}, min rtt:{}", m_id, ModeName(), MaxBw(), m_minRtt.ToDebuggingValue());
+}
+
+void BBRCongestionCtrl::UpdateCwnd(uint32_t ackedCnt)
+{
+    if (MaxBw() > 0 && !m_minRtt.IsInfinite())
+    {
+        uint32_t target = InflightTarget(m_cwndGain);
+        if (m_filledPipe)
+        {
+            m_cwnd = std::min(m_cwnd + ackedCnt, target);
+        }
+        else if (m_cwnd < target || Delivered() < m_initCwnd)
+        {
+            m_cwnd += ackedCnt;
+        }
+    }
+    m_cwnd = BoundCwnd(m_cwnd);
+    if (m_mode == Mode::probeRtt)
+    {
+        m_cwnd = std::min(m_cwnd, kBBRProbeRttCwnd);
+    }
+}
+
+void BBRCongestionCtrl::UpdatePacingRate(RttStats& rttstats)
+{
+    double bw = MaxBw();
+    if (bw > 0)
+    {
+        double rate = m_pacingGain * bw;
+        // in startup the rate only goes up, an early low sample must not throttle the ramp
+        if (m_filledPipe || rate > m_pacingRate)
+        {
+            m_pacingRate = rate;
+        }
+        return;
+    }
+    // no sample yet, pace the initial window over one round trip
+    Duration rtt = rttstats.SmoothedOrInitialRtt();
+    if (rtt > Duration::Zero())
+    {
+        m_pacingRate = m_pacingGain * m_initCwnd * 1000000.0 / rtt.ToMicroseconds();
+    }
+}
+
+uint32_t BBRCongestionCtrl::GetCWND()
+{
+    return m_cwnd;
+}
+
+double BBRCongestionCtrl::GetPacingRate()
+{
+    return m_pacingRate;
+}
+
+double BBRCongestionCtrl::MaxBw() const
+{
+    return m_maxBwFilter.GetBest();
+}
+
+uint32_t BBRCongestionCtrl::InflightTarget(double gain) const
+{
+    if (m_minRtt.IsInfinite() || MaxBw() <= 0)
+    {
+        return m_initCwnd;
+    }
+    double bdp = MaxBw() * m_minRtt.ToMicroseconds() / 1000000.0;
+    return BoundCwnd(static_cast<uint32_t>(std::ceil(gain * bdp)));
+}
+
+uint32_t BBRCongestionCtrl::BoundCwnd(uint32_t trySetCwnd) const
+{
+    return std::max(m_minCwnd, std::min(trySetCwnd, m_maxCwnd));
+}
+
+const char* BBRCongestionCtrl::ModeName() const
+{
+    switch (m_mode)
+    {
+        case Mode::startup:
+            return "startup";
+        case Mode::drain:
+            return "drain";
+        case Mode::probeBw:
+            return "probeBw";
+        case Mode::probeRtt:
+            return "probeRtt";
+    }
+    return "unknown";
+}
+
+/// HyStart++ constants, RFC 9406 Section 4.3
+constexpr uint32_t kHyStartMinRttSamples = 8;
+constexpr uint32_t kHyStartCssGrowthDivisor = 4;
+constexpr uint32_t kHyStartCssRounds = 5;
+const Duration kHyStartMinRttThresh = Duration::FromMilliseconds(4);
+const Duration kHyStartMaxRttThresh = Duration::FromMilliseconds(16);
+
+CubicCongestionCtrl::CubicCongestionCtrl(const RenoCongestionCtlConfig& wndConfig,
+        const CubicCongestionCtlConfig& ccConfig)
+{
+    m_minCwnd = wndConfig.minCwnd;
+    m_maxCwnd = std::max(wndConfig.maxCwnd, wndConfig.minCwnd);
+    m_cwnd = BoundCwnd(ccConfig.initCwnd);
+    // RFC 9438 Section 4
+    m_c = ccConfig.c;
+    m_beta = ccConfig.beta;
+    m_alpha = 3.0 * (1.0 - m_beta) / (1.0 + m_beta);
+    m_hyStart = ccConfig.hyStart;
+    m_id = rand();
+    SPDLOG_DEBUG("ccid:{} m_minCwnd:{}, m_maxCwnd:{}, m_cwnd:{}", m_id, m_minCwnd, m_maxCwnd, m_cwnd);
+}
+
+CubicCongestionCtrl::~CubicCongestionCtrl()
+{
+    SPDLOG_DEBUG("ccid:{}", m_id);
+}
+
+CongestionCtlType CubicCongestionCtrl::GetCCtype()
+{
+    return CongestionCtlType::cubic;
+}
+
+void CubicCongestionCtrl::OnDataSent(const InflightPacket& sentpkt)
+{
+    m_largestSentSeq = std::max(m_largestSentSeq, sentpkt.seq);
+}
+
+void CubicCongestionCtrl::OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats)
+{
+    Timepoint now = Clock::GetClock()->Now();
+    if (lossEvent.valid)
+    {
+        OnDataLoss(lossEvent, now);
+    }
+    if (ackEvent.valid)
+    {
+        OnDataRecv(ackEvent, now, rttstats);
+    }
+}
+
+void CubicCongestionCtrl::OnDataRecv(const AckEvent& ackEvent, Timepoint now, RttStats& rttstats)
+{
+    if (InSlowStart())
+    {
+        m_cwnd += m_hyStart ? HyStartOnAck(ackEvent, rttstats) : 1.0;
+    }
+    else
+    {
+        m_cwnd += CubicOnAck(now, rttstats);
+    }
+    m_cwnd = BoundCwnd(m_cwnd);
+    SPDLOG_TRACE("ccid:{} ack seq:{}, m_cwnd:{}, m_ssThresh:{}", m_id, ackEvent.ackPacket.seq, m_cwnd, m_ssThresh);
+    DEMO_TRACE_CC(TraceEvent::ccAck, ackEvent.ackPacket.seq, ackEvent.ackPacket.pieceId, now.ToDebuggingValue(),
+            ackEvent.sendtic.ToDebuggingValue(), GetCWND(), 0);
+}
+
+double CubicCongestionCtrl::HyStartOnAck(const AckEvent& ackEvent, RttStats& rttstats)
+{
+    if (ackEvent.ackPacket.seq > m_roundEndSeq)
+    {
+        m_roundEndSeq = m_largestSentSeq;
+        m_lastRoundMinRtt = m_currRoundMinRtt;
+        m_currRoundMinRtt = Duration::Infinite();
+        m_rttSampleCnt = 0;
+        if (m_inCss && ++m_cssRounds >= kHyStartCssRounds)
+        {
+            // the delay increase persisted through CSS, leave slow start
+            m_ssThresh = m_cwnd;
+            m_inCss = false;
+            SPDLOG_DEBUG("ccid:{} HyStart++ exit slow start, m_cwnd:{}", m_id, m_cwnd);
+            return 0;
+        }
+    }
+
+    Duration rtt = rttstats.latest_rtt();
+    if (rtt > Duration::Zero())
+    {
+        m_currRoundMinRtt = std::min(m_currRoundMinRtt, rtt);
+        ++m_rttSampleCnt;
+    }
+
+    if (m_rttSampleCnt >= kHyStartMinRttSamples && !m_currRoundMinRtt.IsInfinite() &&
+        !m_lastRoundMinRtt.IsInfinite())
+    {
+        if (!m_inCss)
+        {
+            Duration rttThresh = std::max(kHyStartMinRttThresh,
+                    std::min(Duration::FromMicroseconds(m_lastRoundMinRtt.ToMicroseconds() / 8), kHyStartMaxRttThresh));
+            if (m_currRoundMinRtt >= m_lastRoundMinRtt + rttThresh)
+            {
+                m_inCss = true;
+                m_cssRounds = 0;
+                m_cssBaselineMinRtt = m_currRoundMinRtt;
+                SPDLOG_DEBUG("ccid:{} HyStart++ enter CSS, m_cwnd:{}, rtt:{}", m_id, m_cwnd,
+                        m_currRoundMinRtt.ToDebuggingValue());
+            }
+        }
+        else if (m_currRoundMinRtt < m_cssBaselineMinRtt)
+        {
+            // the delay increase was spurious, resume slow start
+            m_inCss = false;
+            m_cssBaselineMinRtt = Duration::Infinite();
+        }
+    }
+    return m_inCss ? 1.0 / kHyStartCssGrowthDivisor : 1.0;
+}
+
+double CubicCongestionCtrl::CubicOnAck(Timepoint now, RttStats& rttstats)
+{
+    if (!m_epochStart.IsInitialized())
+    {
+        m_epochStart = now;
+        if (m_cwnd < m_wMax)
+        {
+            m_k = std::cbrt((m_wMax - m_cwnd) / m_c);
+            m_origin = m_wMax;
+        }
+        else
+        {
+            m_k = 0;
+            m_origin = m_cwnd;
+        }
+        m_wEst = m_cwnd;
+    }
+
+    // where the cubic curve will be one RTT from now
+    Duration rtt = rttstats.min_rtt().IsZero() ? rttstats.SmoothedOrInitialRtt() : rttstats.min_rtt();
+    double t = (now - m_epochStart + rtt).ToMicroseconds() / 1000000.0;
+    double target = m_origin + m_c * (t - m_k) * (t - m_k) * (t - m_k);
+    target = std::max(m_cwnd, std::min(target, m_cwnd * 1.5));
+
+    // the window a Reno flow with the same beta would have
+    m_wEst += m_alpha / m_cwnd;
+    double tNow = (now - m_epochStart).ToMicroseconds() / 1000000.0;
+    double cubicNow = m_origin + m_c * (tNow - m_k) * (tNow - m_k) * (tNow - m_k);
+    if (cubicNow < m_wEst)
+    {
+        // Reno-friendly region
+        return std::max(0.0, m_wEst - m_cwnd);
+    }
+    return (target - m_cwnd) / m_cwnd;
+}
+
+void CubicCongestionCtrl::OnDataLoss(const LossEvent& lossEvent, Timepoint now)
+{
+    Timepoint maxsentTic{ Timepoint::Zero() };
+    SeqNumber minLostSeq = MAX_SEQNUMBER;
+    SeqNumber maxLostSeq = 0;
+    for (const auto& lostpkt: lossEvent.lossPackets)
+    {
+        maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
+        minLostSeq = std::min(minLostSeq, lostpkt.seq);
+        maxLostSeq = std::max(maxLostSeq, lostpkt.seq);
+        DEMO_TRACE_CC(TraceEvent::ccLoss, lostpkt.seq, lostpkt.pieceId, lossEvent.losttic.ToDebuggingValue(),
+                lostpkt.sendtic.ToDebuggingValue(), GetCWND(), 0);
+    }
+    if (m_recoveryStart.IsInitialized() && maxsentTic <= m_recoveryStart)
+    {
+        // sent before the last reduction, part of the same congestion event
+        m_undoMinLostSeq = std::min(m_undoMinLostSeq, minLostSeq);
+        m_undoMaxLostSeq = std::max(m_undoMaxLostSeq, maxLostSeq);
+        return;
+    }
+    m_recoveryStart = now;
+    m_undoValid = true;
+    m_undoCwnd = m_cwnd;
+    m_undoSsThresh = m_ssThresh;
+    m_undoWMax = m_wMax;
+    m_undoWLastMax = m_wLastMax;
+    m_undoMinLostSeq = minLostSeq;
+    m_undoMaxLostSeq = maxLostSeq;
+
+    // fast convergence: release bandwidth to newer flows when the window keeps shrinking
+    if (m_cwnd < m_wLastMax)
+    {
+        m_wLastMax = m_cwnd;
+        m_wMax = m_cwnd * (1.0 + m_beta) / 2.0;
+    }
+    else
+    {
+        m_wLastMax = m_cwnd;
+        m_wMax = m_cwnd;
+    }
+    m_cwnd = BoundCwnd(m_cwnd * m_beta);
+    m_ssThresh = m_cwnd;
+    m_epochStart = Timepoint::Zero();
+    m_inCss = false;
+    SPDLOG_DEBUG("ccid:{} loss, m_wMax:{}, m_cwnd:{}", m_id, m_wMax, m_cwnd);
+}
+
+void CubicCongestionCtrl::OnSpuriousLoss(const InflightPacket& lostpkt)
+{
+    if (!m_undoValid || lostpkt.seq < m_undoMinLostSeq || lostpkt.seq > m_undoMaxLostSeq)
+    {
+        return;
+    }
+    m_cwnd = BoundCwnd(std::max(m_cwnd, m_undoCwnd));
+    m_ssThresh = m_undoSsThresh == 0 ? 0 : std::max(m_ssThresh, m_undoSsThresh);
+    m_wMax = m_undoWMax;
+    m_wLastMax = m_undoWLastMax;
+    m_epochStart = Timepoint::Zero();
+    m_undoValid = false;
+    SPDLOG_DEBUG("ccid:{} spurious loss seq:{}, undo m_cwnd:{}", m_id, lostpkt.seq, m_cwnd);
+}
+
+uint32_t CubicCongestionCtrl::GetCWND()
+{
+    return static_cast<uint32_t>(m_cwnd);
+}
+
+double CubicCongestionCtrl::BoundCwnd(double trySetCwnd) const
+{
+    return std::max(m_minCwnd, std::min(trySetCwnd, m_maxCwnd));
+}
+
+bool CubicCongestionCtrl::InSlowStart() const
+{
+    return m_ssThresh == 0 || m_cwnd < m_ssThresh;
+}
+
+const char* CoupledCongestionCtlConfig::AlgoName(CoupledIncreaseAlgo algo)
+{
+    switch (algo)
+    {
+        case CoupledIncreaseAlgo::lia:
+            return "lia";
+        case CoupledIncreaseAlgo::olia:
+            return "olia";
+        case CoupledIncreaseAlgo::balia:
+            return "balia";
+    }
+    return "unknown";
+}
+
+bool CoupledCongestionCtlConfig::AlgoFromName(const std::string& name, CoupledIncreaseAlgo& algo)
+{
+    for (auto candidate: { CoupledIncreaseAlgo::lia, CoupledIncreaseAlgo::olia, CoupledIncreaseAlgo::balia })
+    {
+        if (name == AlgoName(candidate))
+        {
+            algo = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CoupledCongestionCtlGroup::Join(CoupledCongestionCtrl* member)
+{
+    if (std::find(m_members.begin(), m_members.end(), member) == m_members.end())
+    {
+        m_members.push_back(member);
+    }
+}
+
+void CoupledCongestionCtlGroup::Leave(CoupledCongestionCtrl* member)
+{
+    m_members.erase(std::remove(m_members.begin(), m_members.end(), member), m_members.end());
+}
+
+double CoupledCongestionCtlGroup::IncreaseOnAck(const CoupledCongestionCtrl& member, CoupledIncreaseAlgo algo) const
+{
+    switch (algo)
+    {
+        case CoupledIncreaseAlgo::olia:
+            return OliaIncrease(member);
+        case CoupledIncreaseAlgo::balia:
+            return BaliaIncrease(member);
+        case CoupledIncreaseAlgo::lia:
+        default:
+            return LiaIncrease(member);
+    }
+}
+
+double CoupledCongestionCtlGroup::DecreaseOnLoss(const CoupledCongestionCtrl& member, CoupledIncreaseAlgo algo) const
+{
+    if (algo != CoupledIncreaseAlgo::balia)
+    {
+        return 0.5;
+    }
+    // BALIA backs off harder on the sessions that are slower than the fastest one
+    double maxRate = 0;
+    for (auto&& other: m_members)
+    {
+        maxRate = std::max(maxRate, other->Cwnd() / other->Rtt());
+    }
+    double alpha = maxRate / (member.Cwnd() / member.Rtt());
+    return 0.5 * std::min(alpha, 1.5);
+}
+
+double CoupledCongestionCtlGroup::LiaIncrease(const CoupledCongestionCtrl& member) const
+{
+    // RFC 6356 Section 3: min(alpha * acked / cwnd_total, acked / cwnd_i)
+    double totalCwnd = 0;
+    double maxWndOverRtt2 = 0;
+    double sumWndOverRtt = 0;
+    for (auto&& other: m_members)
+    {
+        totalCwnd += other->Cwnd();
+        maxWndOverRtt2 = std::max(maxWndOverRtt2, other->Cwnd() / (other->Rtt() * other->Rtt()));
+        sumWndOverRtt += other->Cwnd() / other->Rtt();
+    }
+    double alpha = totalCwnd * maxWndOverRtt2 / (sumWndOverRtt * sumWndOverRtt);
+    return std::min(alpha / totalCwnd, 1.0 / member.Cwnd());
+}
+
+double CoupledCongestionCtlGroup::OliaIncrease(const CoupledCongestionCtrl& member) const
+{
+    /** (w_r / rtt_r^2) / (sum w_p / rtt_p)^2 + alpha_r / w_r, alpha_r moves window from the largest windows to the
+     *  best paths, the ones with the most pieces between losses per rtt^2, that don't have the largest window yet
+     * */
+    double sumWndOverRtt = 0;
+    double maxWnd = 0;
+    double maxQuality = 0;
+    for (auto&& other: m_members)
+    {
+        sumWndOverRtt += other->Cwnd() / other->Rtt();
+        maxWnd = std::max(maxWnd, other->Cwnd());
+        maxQuality = std::max(maxQuality, other->InterLossPieces() / (other->Rtt() * other->Rtt()));
+    }
+    auto isMaxWnd = [maxWnd](const CoupledCongestionCtrl& ctl)
+    {
+        return ctl.Cwnd() >= maxWnd;
+    };
+    auto isBest = [maxQuality](const CoupledCongestionCtrl& ctl)
+    {
+        return ctl.InterLossPieces() / (ctl.Rtt() * ctl.Rtt()) >= maxQuality;
+    };
+    size_t maxWndCnt = 0;
+    size_t bestNotMaxWndCnt = 0;
+    for (auto&& other: m_members)
+    {
+        if (isMaxWnd(*other))
+        {
+            ++maxWndCnt;
+        }
+        else if (isBest(*other))
+        {
+            ++bestNotMaxWndCnt;
+        }
+    }
+    double alpha = 0;
+    double memberCnt = m_members.size();
+    if (bestNotMaxWndCnt > 0)
+    {
+        if (isMaxWnd(member))
+        {
+            alpha = -1.0 / (memberCnt * maxWndCnt);
+        }
+        else if (isBest(member))
+        {
+            alpha = 1.0 / (memberCnt * bestNotMaxWndCnt);
+        }
+    }
+    double rtt = member.Rtt();
+    return (member.Cwnd() / (rtt * rtt)) / (sumWndOverRtt * sumWndOverRtt) + alpha / member.Cwnd();
+}
+
+double CoupledCongestionCtlGroup::BaliaIncrease(const CoupledCongestionCtrl& member) const
+{
+    // (x_r / rtt_r) / (sum x_k)^2 * (1 + alpha_r) / 2 * (4 + alpha_r) / 5, x = w / rtt, alpha_r = max x_k / x_r
+    double sumRate = 0;
+    double maxRate = 0;
+    for (auto&& other: m_members)
+    {
+        double rate = other->Cwnd() / other->Rtt();
+        sumRate += rate;
+        maxRate = std::max(maxRate, rate);
+    }
+    double rate = member.Cwnd() / member.Rtt();
+    double alpha = maxRate / rate;
+    return (rate / member.Rtt()) / (sumRate * sumRate) * ((1 + alpha) / 2) * ((4 + alpha) / 5);
+}
+
+CoupledCongestionCtrl::CoupledCongestionCtrl(const RenoCongestionCtlConfig& wndConfig,
+        const CoupledCongestionCtlConfig& ccConfig, std::shared_ptr<CoupledCongestionCtlGroup> group)
+        : m_group(std::move(group))
+{
+    m_algo = ccConfig.algo;
+    m_minCwnd = wndConfig.minCwnd;
+    m_maxCwnd = std::max(wndConfig.maxCwnd, wndConfig.minCwnd);
+    m_cwnd = BoundCwnd(ccConfig.initCwnd);
+    m_id = rand();
+    m_group->Join(this);
+    SPDLOG_DEBUG("ccid:{} algo:{} group size:{} m_minCwnd:{}, m_maxCwnd:{}, m_cwnd:{}", m_id,
+            CoupledCongestionCtlConfig::AlgoName(m_algo), m_group->size(), m_minCwnd, m_maxCwnd, m_cwnd);
+}
+
+CoupledCongestionCtrl::~CoupledCongestionCtrl()
+{
+    m_group->Leave(this);
+    SPDLOG_DEBUG("ccid:{}", m_id);
+}
+
+CongestionCtlType CoupledCongestionCtrl::GetCCtype()
+{
+    return CongestionCtlType::coupled;
+}
+
+void CoupledCongestionCtrl::OnDataSent(const InflightPacket& sentpkt)
+{
+    SPDLOG_TRACE("");
+}
+
+void CoupledCongestionCtrl::OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent,
+        RttStats& rttstats)
+{
+    Timepoint now = Clock::GetClock()->Now();
+    if (lossEvent.valid)
+    {
+        OnDataLoss(lossEvent, now);
+    }
+    if (ackEvent.valid)
+    {
+        OnDataRecv(ackEvent, now, rttstats);
+    }
+}
+
+void CoupledCongestionCtrl::OnDataRecv(const AckEvent& ackEvent, Timepoint now, RttStats& rttstats)
+{
+    Duration srtt = rttstats.SmoothedOrInitialRtt();
+    if (srtt > Duration::Zero())
+    {
+        m_rtt = srtt.ToMicroseconds() / 1000000.0;
+    }
+    m_ackedSinceLoss += 1;
+    if (InSlowStart())
+    {
+        m_cwnd += 1;
+    }
+    else
+    {
+        m_cwnd += m_group->IncreaseOnAck(*this, m_algo);
+    }
+    m_cwnd = BoundCwnd(m_cwnd);
+    SPDLOG_TRACE("ccid:{} ack seq:{}, m_cwnd:{}, m_ssThresh:{}", m_id, ackEvent.ackPacket.seq, m_cwnd, m_ssThresh);
+    DEMO_TRACE_CC(TraceEvent::ccAck, ackEvent.ackPacket.seq, ackEvent.ackPacket.pieceId, now.ToDebuggingValue(),
+            ackEvent.sendtic.ToDebuggingValue(), GetCWND(), 0);
+}
+
+void CoupledCongestionCtrl::OnDataLoss(const LossEvent& lossEvent, Timepoint now)
+{
+    Timepoint maxsentTic{ Timepoint::Zero() };
+    SeqNumber minLostSeq = MAX_SEQNUMBER;
+    SeqNumber maxLostSeq = 0;
+    for (const auto& lostpkt: lossEvent.lossPackets)
+    {
+        maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
+        minLostSeq = std::min(minLostSeq, lostpkt.seq);
+        maxLostSeq = std::max(maxLostSeq, lostpkt.seq);
+        DEMO_TRACE_CC(TraceEvent::ccLoss, lostpkt.seq, lostpkt.pieceId, lossEvent.losttic.ToDebuggingValue(),
+                lostpkt.sendtic.ToDebuggingValue(), GetCWND(), 0);
+    }
+    if (m_recoveryStart.IsInitialized() && maxsentTic <= m_recoveryStart)
+    {
+        // sent before the last reduction, part of the same congestion event
+        m_undoMinLostSeq = std::min(m_undoMinLostSeq, minLostSeq);
+        m_undoMaxLostSeq = std::max(m_undoMaxLostSeq, maxLostSeq);
+        return;
+    }
+    m_recoveryStart = now;
+    m_undoValid = true;
+    m_undoCwnd = m_cwnd;
+    m_undoSsThresh = m_ssThresh;
+    m_undoMinLostSeq = minLostSeq;
+    m_undoMaxLostSeq = maxLostSeq;
+
+    m_ackedBetweenLosses = m_ackedSinceLoss;
+    m_ackedSinceLoss = 0;
+    m_cwnd = BoundCwnd(m_cwnd * (1.0 - m_group->DecreaseOnLoss(*this, m_algo)));
+    m_ssThresh = m_cwnd;
+    SPDLOG_DEBUG("ccid:{} loss, m_cwnd:{}", m_id, m_cwnd);
+}
+
+void CoupledCongestionCtrl::OnSpuriousLoss(const InflightPacket& lostpkt)
+{
+    if (!m_undoValid || lostpkt.seq < m_undoMinLostSeq || lostpkt.seq > m_undoMaxLostSeq)
+    {
+        return;
+    }
+    m_cwnd = BoundCwnd(std::max(m_cwnd, m_undoCwnd));
+    m_ssThresh = m_undoSsThresh == 0 ? 0 : std::max(m_ssThresh, m_undoSsThresh);
+    m_undoValid = false;
+    SPDLOG_DEBUG("ccid:{} spurious loss seq:{}, undo m_cwnd:{}", m_id, lostpkt.seq, m_cwnd);
+}
+
+void CoupledCongestionCtrl::SetCoupledGroup(std::shared_ptr<CoupledCongestionCtlGroup> group)
+{
+    if (!group || group == m_group)
+    {
+        return;
+    }
+    m_group->Leave(this);
+    m_group = std::move(group);
+    m_group->Join(this);
+    SPDLOG_DEBUG("ccid:{} moved to a group of size:{}", m_id, m_group->size());
+}
+
+uint32_t CoupledCongestionCtrl::GetCWND()
+{
+    return static_cast<uint32_t>(m_cwnd);
+}
+
+double CoupledCongestionCtrl::BoundCwnd(double trySetCwnd) const
+{
+    return std::max(m_minCwnd, std::min(trySetCwnd, m_maxCwnd));
+}
+
+bool CoupledCongestionCtrl::InSlowStart() const
+{
+    return m_ssThresh == 0 || m_cwnd < m_ssThresh;
+}
+
+std::string CongestionCtlConfig::DebugInfo() const
+{
+    std::stringstream ss;
+    ss << "{type:" << CongestionCtlFactory::TypeName(type)
+       << " minCwnd:" << reno.minCwnd << " maxCwnd:" << reno.maxCwnd << " ssThresh:" << reno.ssThresh;
+    switch (type)
+    {
+        case CongestionCtlType::bbr:
+            ss << " initCwnd:" << bbr.initCwnd << " cwndGain:" << bbr.cwndGain
+               << " minRttWindowMs:" << bbr.minRttWindowMs << " probeRttDurationMs:" << bbr.probeRttDurationMs;
+            break;
+        case CongestionCtlType::cubic:
+            ss << " initCwnd:" << cubic.initCwnd << " c:" << cubic.c << " beta:" << cubic.beta
+               << " hyStart:" << cubic.hyStart;
+            break;
+        case CongestionCtlType::coupled:
+            ss << " initCwnd:" << coupled.initCwnd << " algo:" << CoupledCongestionCtlConfig::AlgoName(coupled.algo)
+               << " group size:" << (coupledGroup ? coupledGroup->size() : 0);
+            break;
+        default:
+            break;
+    }
+    ss << "}";
+    return ss.str();
+}
+
+CongestionCtlFactory& CongestionCtlFactory::Instance()
+{
+    static CongestionCtlFactory factory;
+    return factory;
+}
+
+CongestionCtlFactory::CongestionCtlFactory()
+{
+    Register(CongestionCtlType::reno, [](const CongestionCtlConfig& ccConfig)
+    {
+        return std::unique_ptr<CongestionCtlAlgo>(new RenoCongestionContrl(ccConfig.reno));
+    });
+    Register(CongestionCtlType::test, [](const CongestionCtlConfig& ccConfig)
+    {
+        RenoCongestionCtlConfig renoConfig = ccConfig.reno;
+        return std::unique_ptr<CongestionCtlAlgo>(new TestCongestionCtrl(TestCongestionCtlConfig(renoConfig)));
+    });
+    Register(CongestionCtlType::bbr, [](const CongestionCtlConfig& ccConfig)
+    {
+        return std::unique_ptr<CongestionCtlAlgo>(new BBRCongestionCtrl(ccConfig.reno, ccConfig.bbr));
+    });
+    Register(CongestionCtlType::cubic, [](const CongestionCtlConfig& ccConfig)
+    {
+        return std::unique_ptr<CongestionCtlAlgo>(new CubicCongestionCtrl(ccConfig.reno, ccConfig.cubic));
+    });
+    Register(CongestionCtlType::coupled, [](const CongestionCtlConfig& ccConfig)
+    {
+        // without a group the session is coupled with nothing and behaves like reno
+        auto group = ccConfig.coupledGroup ? ccConfig.coupledGroup : std::make_shared<CoupledCongestionCtlGroup>();
+        return std::unique_ptr<CongestionCtlAlgo>(new CoupledCongestionCtrl(ccConfig.reno, ccConfig.coupled, group));
+    });
+}
+
+void CongestionCtlFactory::Register(CongestionCtlType type, Creator creator)
+{
+    m_creators[type] = std::move(creator);
+}
+
+std::unique_ptr<CongestionCtlAlgo> CongestionCtlFactory::Create(const CongestionCtlConfig& ccConfig) const
+{
+    auto itor = m_creators.find(ccConfig.type);
+    if (itor == m_creators.end())
+    {
+        SPDLOG_ERROR("congestion control type {} is not registered", TypeName(ccConfig.type));
+        return nullptr;
+    }
+    return itor->second(ccConfig);
+}
+
+bool CongestionCtlFactory::TypeFromName(const std::string& name, CongestionCtlType& type) const
+{
+    for (auto&& type_creator: m_creators)
+    {
+        if (name == TypeName(type_creator.first))
+        {
+            type = type_creator.first;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* CongestionCtlFactory::TypeName(CongestionCtlType type)
+{
+    switch (type)
+    {
+        case CongestionCtlType::none:
+            return "none";
+        case CongestionCtlType::reno:
+            return "reno";
+        case CongestionCtlType::test:
+            return "test";
+        case CongestionCtlType::bbr:
+            return "bbr";
+        case CongestionCtlType::cubic:
+            return "cubic";
+        case CongestionCtlType::coupled:
+            return "coupled";
+    }
+    return "unknown";
+}
@@ -5,13 +5,19 @@
 
 #include <cstdint>
 #include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 #include "utils/thirdparty/quiche/rtt_stats.h"
+#include "utils/thirdparty/quiche/windowed_filter.h"
 #include "basefw/base/log.h"
 #include "utils/rttstats.h"
 #include "utils/transporttime.h"
 #include "utils/defaultclock.hpp"
 #include "sessionstreamcontroller.hpp"
 #include "packettype.h"
+#include "deliveryratesampler.hpp"
 #include "json.hpp"
 
 using json = nlohmann::json;
@@ -20,7 +26,10 @@ enum class CongestionCtlType : uint8_t
 {
     none = 0,
     reno = 1,
-    test = 2
+    test = 2,
+    bbr = 3,
+    cubic = 4,
+    coupled = 5
 };
 
 struct LossEvent
@@ -80,7 +89,7 @@ public:
      * @param downloadingmap all the packets inflight, sent but not acked or lost
      * @param eventtime timpoint that this function is called
      * @param ackEvent  ack event that trigger this function, if any
-     * @param maxacked max sequence number that has acked
+     * @param maxacked max sequence number that has acked, MAX_SEQNUMBER if nothing acked yet
      * @param rttStats RTT statics module
      * output
      * @param losses loss event
@@ -90,6 +99,25 @@ public:
     {
     };
 
+    /** @brief how long after being sent an unacked packet is declared lost, used to arm per-packet loss timers
+     * @param rttStats RTT statics module
+     * */
+    virtual Duration GetLossDelay(RttStats& rttStats)
+    {
+        return Duration::Infinite();
+    }
+
+    /** @brief a packet declared lost has been received after all, the algo may relax its thresholds
+     * @param lostpkt the packet as it was when declared lost
+     * @param recvtic timepoint that the packet is received
+     * @param maxacked max sequence number that has acked, MAX_SEQNUMBER if nothing acked yet
+     * @param rttStats RTT statics module, not yet updated with this packet
+     * */
+    virtual void OnSpuriousLoss(const InflightPacket& lostpkt, Timepoint recvtic, uint64_t maxacked,
+            RttStats& rttStats)
+    {
+    }
+
     virtual ~LossDetectionAlgo() = default;
 
 };
@@ -100,8 +128,30 @@ public:
     void DetectLoss(const InFlightPacketMap& downloadingmap, Timepoint eventtime, const AckEvent& ackEvent,
             uint64_t maxacked, LossEvent& losses, RttStats& rttStats) override
     {
-        SPDLOG_TRACE("inflight: {} eventtime: {} ackEvent:{} ", downloadingmap.DebugInfo(),
-                eventtime.ToDebuggingValue(), ackEvent.DebugInfo());
+        // nothing is logged before the first loss, the alarm runs every 100ms on every session
+        Duration loss_delay = GetLossDelay(rttStats);
+        downloadingmap.VisitInSendOrder([&](const InflightPacket& pkt)
+        {
+            if (Timepoint(pkt.sendtic + loss_delay) <= eventtime)
+            {
+                losses.lossPackets.emplace_back(pkt);
+                DEMO_TRACE_LOSS(TraceEvent::pktLost, pkt.seq, pkt.pieceId, eventtime.ToDebuggingValue(),
+                        pkt.sendtic.ToDebuggingValue(), 0, downloadingmap.InFlightPktNum());
+                return true;
+            }
+            // every packet after this one was sent later, none of them has expired
+            return false;
+        });
+        if (!losses.lossPackets.empty())
+        {
+            losses.losttic = eventtime;
+            losses.valid = true;
+            SPDLOG_DEBUG("lost pkt cnt: {}", losses.lossPackets.size());
+        }
+    }
+
+    Duration GetLossDelay(RttStats& rttStats) override
+    {
         /** RFC 9002 Section 6
          * */
         Duration maxrtt = std::max(rttStats.previous_srtt(), rttStats.latest_rtt());
@@ -111,32 +161,148 @@ public:
             maxrtt = rttStats.SmoothedOrInitialRtt();
         }
         Duration loss_delay = maxrtt + (maxrtt * (5.0 / 4.0));
-        loss_delay = std::max(loss_delay, Duration::FromMicroseconds(1));
-        SPDLOG_TRACE(" maxrtt: {}, loss_delay: {}", maxrtt.ToDebuggingValue(), loss_delay.ToDebuggingValue());
-        for (const auto& pkt_itor: downloadingmap.inflightPktMap)
+        return std::max(loss_delay, Duration::FromMicroseconds(1));
+    }
+
+    ~DefaultLossDetectionAlgo() override
+    {
+    }
+
+private:
+};
+
+class PacketThresholdLossDetectionAlgo : public LossDetectionAlgo
+{/// Check loss event based on both packet and time threshold, RFC 9002 Section 6.1
+public:
+    void DetectLoss(const InFlightPacketMap& downloadingmap, Timepoint eventtime, const AckEvent& ackEvent,
+            uint64_t maxacked, LossEvent& losses, RttStats& rttStats) override
+    {
+        SPDLOG_TRACE("inflight cnt: {} eventtime: {} maxacked: {}", downloadingmap.InFlightPktNum(),
+                eventtime.ToDebuggingValue(), maxacked);
+        bool hasAcked = maxacked < MAX_SEQNUMBER;
+        if (hasAcked && ackEvent.valid && ackEvent.ackPacket.seq < maxacked)
         {
-            const auto& pkt = pkt_itor.second;
-            if (Timepoint(pkt.sendtic + loss_delay) <= eventtime)
+            // the acked packet arrived after a later one, make room for this much reordering
+            OnReorderObserved(maxacked - ackEvent.ackPacket.seq);
+        }
+
+        /** Packet threshold: kPacketThreshold later packets have been acked.
+         *  Walk in seq order and stop at the first packet that is too new.
+         * */
+        SeqNumber largestThresholdLost = 0;
+        bool anyThresholdLost = false;
+        if (hasAcked && maxacked >= m_packetThreshold)
+        {
+            for (const auto& seq_pkt: downloadingmap.inflightPktMap)
             {
-                losses.lossPackets.emplace_back(pkt);
+                if (uint64_t(seq_pkt.first) + m_packetThreshold > maxacked)
+                {
+                    break;
+                }
+                losses.lossPackets.emplace_back(seq_pkt.second);
+                largestThresholdLost = seq_pkt.first;
+                anyThresholdLost = true;
+                DEMO_TRACE_LOSS(TraceEvent::pktLost, seq_pkt.first, seq_pkt.second.pieceId,
+                        eventtime.ToDebuggingValue(), seq_pkt.second.sendtic.ToDebuggingValue(),
+                        m_packetThreshold, downloadingmap.InFlightPktNum());
             }
         }
+
+        /** Time threshold, on the remaining packets in send order
+         * */
+        Duration loss_delay = GetLossDelay(rttStats);
+        downloadingmap.VisitInSendOrder([&](const InflightPacket& pkt)
+        {
+            if (Timepoint(pkt.sendtic + loss_delay) > eventtime)
+            {
+                return false;
+            }
+            if (!anyThresholdLost || pkt.seq > largestThresholdLost)
+            {
+                losses.lossPackets.emplace_back(pkt);
+                DEMO_TRACE_LOSS(TraceEvent::pktLost, pkt.seq, pkt.pieceId, eventtime.ToDebuggingValue(),
+                        pkt.sendtic.ToDebuggingValue(), 0, downloadingmap.InFlightPktNum());
+            }
+            return true;
+        });
+
         if (!losses.lossPackets.empty())
         {
             losses.losttic = eventtime;
             losses.valid = true;
-            SPDLOG_DEBUG("losses: {}", losses.DebugInfo());
+            SPDLOG_DEBUG("lost pkt cnt: {}, packet threshold: {}", losses.lossPackets.size(), m_packetThreshold);
         }
     }
 
-    ~DefaultLossDetectionAlgo() override
+    Duration GetLossDelay(RttStats& rttStats) override
+    {
+        /** RFC 9002 Section 6.1.2
+         *  max(kTimeThreshold * max(smoothed_rtt, latest_rtt), kGranularity)
+         * */
+        Duration maxrtt = std::max(rttStats.smoothed_rtt(), rttStats.latest_rtt());
+        if (maxrtt == Duration::Zero())
+        {
+            maxrtt = rttStats.SmoothedOrInitialRtt();
+        }
+        Duration loss_delay = maxrtt * m_timeThreshold;
+        return std::max(loss_delay, kGranularity);
+    }
+
+    void OnSpuriousLoss(const InflightPacket& lostpkt, Timepoint recvtic, uint64_t maxacked,
+            RttStats& rttStats) override
+    {
+        if (maxacked < MAX_SEQNUMBER && maxacked > lostpkt.seq)
+        {
+            OnReorderObserved(maxacked - lostpkt.seq);
+        }
+        /** RFC 9002 Section 6.1.2: an implementation MAY raise the time threshold after spurious losses.
+         *  Only do so if the packet really took longer than the current loss delay.
+         * */
+        if (recvtic - lostpkt.sendtic > GetLossDelay(rttStats) && m_timeThreshold < kMaxTimeThreshold)
+        {
+            m_timeThreshold += kTimeThresholdStep;
+            if (m_timeThreshold > kMaxTimeThreshold)
+            {
+                m_timeThreshold = kMaxTimeThreshold;
+            }
+            SPDLOG_DEBUG("late arrival seq {}, time threshold now {}", lostpkt.seq, m_timeThreshold);
+        }
+    }
+
+    /// a packet was acked reorderDistance sequence numbers after a later one
+    void OnReorderObserved(uint64_t reorderDistance)
+    {
+        if (reorderDistance >= m_packetThreshold)
+        {
+            m_packetThreshold = static_cast<uint32_t>(std::min<uint64_t>(reorderDistance + 1, kMaxPacketThreshold));
+            SPDLOG_DEBUG("reorder distance {}, packet threshold now {}", reorderDistance, m_packetThreshold);
+        }
+    }
+
+    uint32_t GetPacketThreshold() const
+    {
+        return m_packetThreshold;
+    }
+
+    ~PacketThresholdLossDetectionAlgo() override
     {
     }
 
 private:
+    static constexpr uint32_t kInitPacketThreshold = 3;
+    static constexpr uint32_t kMaxPacketThreshold = 64;
+    static constexpr double kInitTimeThreshold = 9.0 / 8.0;
+    static constexpr double kMaxTimeThreshold = 9.0 / 4.0;/** the factor of DefaultLossDetectionAlgo*/
+    static constexpr double kTimeThresholdStep = 1.0 / 8.0;
+    const Duration kGranularity{ Duration::FromMilliseconds(1) };
+
+    uint32_t m_packetThreshold{ kInitPacketThreshold };/** adaptive, grows with the reordering observed*/
+    double m_timeThreshold{ kInitTimeThreshold };/** adaptive, grows with the spurious losses observed*/
 };
 
 
+class CoupledCongestionCtlGroup;
+
 class CongestionCtlAlgo
 {
 public:
@@ -150,11 +316,40 @@ public:
 
     virtual void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) = 0;
 
+    /// a packet reported in an earlier loss event has been received, the loss was spurious
+    virtual void OnSpuriousLoss(const InflightPacket& lostpkt)
+    {
+    }
+
     /////
     virtual uint32_t GetCWND() = 0;
 
+    /// pieces per second the requests should be paced at, 0 if the algo doesn't pace
+    virtual double GetPacingRate()
+    {
+        return 0;
+    }
+
+    /// the sessions sharing a bottleneck with this one have changed, only coupled algos care
+    virtual void SetCoupledGroup(std::shared_ptr<CoupledCongestionCtlGroup> group)
+    {
+    }
+
+    /// the delivery rate sampler of the session, it is fed before OnDataSent and OnDataAckOrLoss are called
+    void SetDeliveryRateSampler(const DeliveryRateSampler* sampler)
+    {
+        m_rateSampler = sampler;
+    }
+
+    const DeliveryRateSampler* GetDeliveryRateSampler() const
+    {
+        return m_rateSampler;
+    }
+
 //    virtual uint32_t GetFreeCWND() = 0;
 
+protected:
+    const DeliveryRateSampler* m_rateSampler{ nullptr };/** owned by the session, null if not set*/
 };
 
 /// config or setting for specific cc algo
@@ -195,7 +390,6 @@ public:
 
     void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override
     {
-        SPDLOG_TRACE("ackevent:{}, lossevent:{}", ackEvent.DebugInfo(), lossEvent.DebugInfo());
         if (lossEvent.valid)
         {
             OnDataLoss(lossEvent);
@@ -208,6 +402,21 @@ public:
 
     }
 
+    void OnSpuriousLoss(const InflightPacket& lostpkt) override
+    {
+        /** Undo the reduction of the latest loss event if one of its packets shows up, like the Eifel response.
+         *  Older reductions have been superseded by the latest one and are kept.
+         * */
+        if (!m_undoValid || lostpkt.seq < m_undoMinLostSeq || lostpkt.seq > m_undoMaxLostSeq)
+        {
+            return;
+        }
+        m_cwnd = BoundCwnd(std::max(m_cwnd, m_undoCwnd));
+        m_ssThresh = std::max(m_ssThresh, m_undoSsThresh);
+        m_undoValid = false;
+        SPDLOG_DEBUG("spurious loss seq:{}, undo m_cwnd={}, m_ssThresh={}", lostpkt.seq, m_cwnd, m_ssThresh);
+    }
+
     /////
     uint32_t GetCWND() override
     {
@@ -266,7 +475,7 @@ private:
 
     void OnDataRecv(const AckEvent& ackEvent)
     {
-        SPDLOG_DEBUG("ackevent:{},m_cwnd:{}", ackEvent.DebugInfo(), m_cwnd);
+        SPDLOG_DEBUG("ack seq:{},m_cwnd:{}", ackEvent.ackPacket.seq, m_cwnd);
         if (InSlowStart())
         {
             /// add 1 for each ack event
@@ -287,24 +496,33 @@ private:
             {
                 m_cwndCnt = 0;
             }
-            SPDLOG_DEBUG("not in slow start state,new m_cwndCnt:{} new m_cwnd:{}",
-                    m_cwndCnt, ackEvent.DebugInfo(), m_cwnd);
+            SPDLOG_DEBUG("not in slow start state,new m_cwndCnt:{} new m_cwnd:{}", m_cwndCnt, m_cwnd);
 
         }
         m_cwnd = BoundCwnd(m_cwnd);
 
         SPDLOG_DEBUG("after RX, m_cwnd={}", m_cwnd);
+        DEMO_TRACE_CC(TraceEvent::ccAck, ackEvent.ackPacket.seq, ackEvent.ackPacket.pieceId, 0,
+                ackEvent.sendtic.ToDebuggingValue(), m_cwnd, 0);
     }
 
     void OnDataLoss(const LossEvent& lossEvent)
     {
-        SPDLOG_DEBUG("lossevent:{}", lossEvent.DebugInfo());
+        SPDLOG_DEBUG("lost pkt cnt:{}", lossEvent.lossPackets.size());
         Timepoint maxsentTic{ Timepoint::Zero() };
 
+        m_undoMinLostSeq = MAX_SEQNUMBER;
+        m_undoMaxLostSeq = 0;
         for (const auto& lostpkt: lossEvent.lossPackets)
         {
             maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
+            m_undoMinLostSeq = std::min(m_undoMinLostSeq, lostpkt.seq);
+            m_undoMaxLostSeq = std::max(m_undoMaxLostSeq, lostpkt.seq);
         }
+        // remember the state before the cut, in case the loss turns out to be spurious
+        m_undoCwnd = m_cwnd;
+        m_undoSsThresh = m_ssThresh;
+        m_undoValid = true;
 
         /** In Recovery phase, cwnd will decrease 1 pkt for each lost pkt
          *  Otherwise, cwnd will cut half.
@@ -326,6 +544,11 @@ private:
             // enter Recovery state
         }
         SPDLOG_DEBUG("after Loss, m_cwnd={}", m_cwnd);
+        for (const auto& lostpkt: lossEvent.lossPackets)
+        {
+            DEMO_TRACE_CC(TraceEvent::ccLoss, lostpkt.seq, lostpkt.pieceId, lossEvent.losttic.ToDebuggingValue(),
+                    lostpkt.sendtic.ToDebuggingValue(), m_cwnd, 0);
+        }
     }
 
 
@@ -338,6 +561,11 @@ private:
     uint32_t m_cwndCnt{ 0 }; /** in congestion avoid phase, used for counting ack packets*/
     Timepoint lastLagestLossPktSentTic{ Timepoint::Zero() };
 
+    bool m_undoValid{ false };
+    uint32_t m_undoCwnd{ 1 };/** m_cwnd before the latest loss event*/
+    uint32_t m_undoSsThresh{ 32 };/** m_ssThresh before the latest loss event*/
+    SeqNumber m_undoMinLostSeq{ MAX_SEQNUMBER };/** seq range of the latest loss event*/
+    SeqNumber m_undoMaxLostSeq{ 0 };
 
     uint32_t m_minCwnd{ 1 };
     uint32_t m_maxCwnd{ 64 };
@@ -369,7 +597,7 @@ struct Interval
     QuicTime first_send_tic{QuicTime::Zero()};
     QuicTime first_recv_tic{QuicTime::Zero()};
     QuicTime last_recv_tic{QuicTime::Zero()};
-    std::set<uint64_t> ackTimeInMs;
+    uint32_t first_sent_seq{MAX_SEQNUMBER}; // first seq sent while this interval is the newest, counted or not
     void OnDataSent(const InflightPacket& sentpkt);
     void CheckIfSentDone(uint32_t seq, QuicTime now);
     void CalculateStatistics();
@@ -406,6 +634,7 @@ public:
     void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override;
     void OnDataRecv(const AckEvent& ackEvent);
     void OnDataLoss(const LossEvent& lossEvent);
+    void OnSpuriousLoss(const InflightPacket& lostpkt) override;
     uint32_t GetCWND() override;
 
 private:
@@ -415,9 +644,334 @@ private:
     float GetHigherProbeGain(float gain);
     float GetLowerProbeGain(float gain);
 
+    /// interval history is a fixed capacity ring indexed by interval serial number, m_intervals[serial % capacity]
+    bool HasInterval(uint64_t serial) const;
+    Interval& IntervalAt(uint64_t serial);
+    Interval& NewestInterval();
+    /// the interval whose seq range holds seq, nullptr if none or it has been dropped
+    Interval* IntervalOfSeq(uint32_t seq);
+    void PushInterval(const Interval& itvl);
+    /// drop the intervals older than serial and the seqs they sent
+    void DropIntervalsBefore(uint64_t serial);
+
     uint32_t m_minCwnd{ 1 };
     uint32_t m_initCwnd{10};
-    std::vector<Interval> m_intervalHistory;
-    uint32_t m_probeIndex;
+    std::vector<Interval> m_intervals;
+    uint64_t m_oldestInterval{ 0 };/** serial of the oldest interval in the ring*/
+    uint64_t m_nextInterval{ 0 };/** serial of the next interval, the ring is empty if equal to m_oldestInterval*/
+    uint64_t m_probeInterval{ 0 };/** serial of the newest probe interval*/
+    bool m_hasProbe{ false };
+    SeqIndexedRing<uint64_t> m_seqToInterval;/** serial of the interval that was the newest when seq was sent*/
+    uint32_t m_id{ 0 };
+};
+
+/// tunables of BBRCongestionCtrl, the window bounds come from RenoCongestionCtlConfig
+struct BBRCongestionCtlConfig
+{
+    uint32_t initCwnd{ 10 };
+    double cwndGain{ 2.0 };/** cwnd gain in ProbeBW*/
+    uint32_t minRttWindowMs{ 10000 };/** ProbeRTT is entered if min RTT is not refreshed for this long*/
+    uint32_t probeRttDurationMs{ 200 };
+};
+
+/// Model based congestion control, after BBR v1 (draft-cardwell-iccrg-bbr-congestion-control-00).
+/// The bottleneck bandwidth is the windowed max of per-request delivery rate samples, the propagation delay is
+/// the windowed min RTT; cwnd and pacing rate are gains over their product. Loss doesn't shrink the window,
+/// so random loss on the path doesn't starve it.
+class BBRCongestionCtrl : public CongestionCtlAlgo
+{
+public:
+    BBRCongestionCtrl(const RenoCongestionCtlConfig& wndConfig, const BBRCongestionCtlConfig& ccConfig);
+    ~BBRCongestionCtrl() override;
+    CongestionCtlType GetCCtype() override;
+    void OnDataSent(const InflightPacket& sentpkt) override;
+    void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override;
+    uint32_t GetCWND() override;
+    double GetPacingRate() override;
+
+private:
+    enum class Mode : uint8_t
+    {
+        startup = 0,
+        drain,
+        probeBw,
+        probeRtt,
+    };
+
+    void OnDataRecv(const RateSample& sample, Timepoint now, RttStats& rttstats);
+    void OnDataLoss(const LossEvent& lossEvent);
+    uint64_t Delivered() const;
+    size_t InflightCnt() const;
+    void UpdateMinRtt(Duration rtt, Timepoint now);
+    void CheckFullPipe();
+    void CheckDrain();
+    void UpdateGainCycle(Timepoint now, bool hadLoss);
+    void CheckProbeRtt(Timepoint now);
+    void EnterMode(Mode mode, Timepoint now);
+    void UpdateCwnd(uint32_t ackedCnt);
+    void UpdatePacingRate(RttStats& rttstats);
+    double MaxBw() const;
+    uint32_t InflightTarget(double gain) const;
+    uint32_t BoundCwnd(uint32_t trySetCwnd) const;
+    const char* ModeName() const;
+
+    uint32_t m_minCwnd{ 4 };/** never below 4, the cwnd of ProbeRTT*/
+    uint32_t m_maxCwnd{ 64 };
+    uint32_t m_initCwnd{ 10 };
+    uint32_t m_cwnd{ 10 };
+    double m_pacingRate{ 0 };/** pieces per second*/
+    double m_probeBwCwndGain{ 2.0 };
+    Duration m_minRttWindow{ Duration::FromSeconds(10) };
+    Duration m_probeRttDuration{ Duration::FromMilliseconds(200) };
+    uint32_t m_id{ 0 };
+
+    Mode m_mode{ Mode::startup };
+    double m_pacingGain{ 1 };
+    double m_cwndGain{ 1 };
+
+    /// round trip counting, a round ends when a request sent after the previous round end is acked
+    uint64_t m_roundCnt{ 0 };
+    uint64_t m_nextRoundDelivered{ 0 };
+    bool m_roundStart{ false };
+
+    quic::WindowedFilter<double, quic::MaxFilter<double>, uint64_t, uint64_t> m_maxBwFilter;/** pieces per second over rounds*/
+    Duration m_minRtt{ Duration::Infinite() };
+    Timepoint m_minRttTic{ Timepoint::Zero() };
+    bool m_minRttExpired{ false };/** the min RTT of this ack replaced one older than m_minRttWindow*/
+
+    /// startup
+    bool m_filledPipe{ false };
+    double m_fullBw{ 0 };
+    uint32_t m_fullBwCnt{ 0 };
+
+    /// ProbeBW
+    uint32_t m_cycleIndex{ 0 };
+    Timepoint m_cycleTic{ Timepoint::Zero() };
+
+    /// ProbeRTT
+    uint32_t m_priorCwnd{ 0 };
+    Timepoint m_probeRttDoneTic{ Timepoint::Zero() };
+    bool m_probeRttRoundDone{ false };
+};
+
+/// tunables of CubicCongestionCtrl, the window bounds come from RenoCongestionCtlConfig
+struct CubicCongestionCtlConfig
+{
+    uint32_t initCwnd{ 10 };
+    double c{ 0.4 };/** cubic scaling constant*/
+    double beta{ 0.7 };/** multiplicative decrease factor*/
+    bool hyStart{ true };/** HyStart++ slow start exit, classic slow start otherwise*/
+};
+
+/// CUBIC congestion control, RFC 9438, with HyStart++ slow start, RFC 9406.
+/// The window grows as a cubic function of the time since the last reduction, so recovering the window on a
+/// high BDP path takes a few RTTs instead of one piece per RTT. Below the Reno-friendly window it grows like Reno.
+class CubicCongestionCtrl : public CongestionCtlAlgo
+{
+public:
+    CubicCongestionCtrl(const RenoCongestionCtlConfig& wndConfig, const CubicCongestionCtlConfig& ccConfig);
+    ~CubicCongestionCtrl() override;
+    CongestionCtlType GetCCtype() override;
+    void OnDataSent(const InflightPacket& sentpkt) override;
+    void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override;
+    void OnSpuriousLoss(const InflightPacket& lostpkt) override;
+    uint32_t GetCWND() override;
+
+private:
+    void OnDataRecv(const AckEvent& ackEvent, Timepoint now, RttStats& rttstats);
+    void OnDataLoss(const LossEvent& lossEvent, Timepoint now);
+    /// HyStart++ round tracking and slow start exit, returns the cwnd increase of this ack
+    double HyStartOnAck(const AckEvent& ackEvent, RttStats& rttstats);
+    double CubicOnAck(Timepoint now, RttStats& rttstats);
+    double BoundCwnd(double trySetCwnd) const;
+    bool InSlowStart() const;
+
+    double m_minCwnd{ 1 };
+    double m_maxCwnd{ 64 };
+    double m_cwnd{ 10 };/** fractional, GetCWND rounds down*/
+    double m_ssThresh{ 0 };/** 0 until the first loss or slow start exit*/
     uint32_t m_id{ 0 };
-};
\ No newline at end of file
+    double m_c{ 0.4 };
+    double m_beta{ 0.7 };
+    double m_alpha{ 0 };/** Reno-friendly additive increase, 3(1-beta)/(1+beta)*/
+    bool m_hyStart{ true };
+
+    /// cubic state, reset by every loss event
+    double m_wMax{ 0 };/** window before the last reduction*/
+    double m_wLastMax{ 0 };/** previous m_wMax, for fast convergence*/
+    double m_k{ 0 };/** seconds from the epoch start until the window reaches m_wMax again*/
+    double m_origin{ 0 };
+    double m_wEst{ 0 };/** the Reno-friendly window*/
+    Timepoint m_epochStart{ Timepoint::Zero() };
+    Timepoint m_recoveryStart{ Timepoint::Zero() };/** losses of requests sent before this are in the same event*/
+
+    /// state before the last reduction, restored if it is found spurious
+    bool m_undoValid{ false };
+    double m_undoCwnd{ 0 };
+    double m_undoSsThresh{ 0 };
+    double m_undoWMax{ 0 };
+    double m_undoWLastMax{ 0 };
+    SeqNumber m_undoMinLostSeq{ MAX_SEQNUMBER };
+    SeqNumber m_undoMaxLostSeq{ 0 };
+
+    /// HyStart++
+    SeqNumber m_largestSentSeq{ 0 };
+    SeqNumber m_roundEndSeq{ 0 };/** a round ends when a request sent after this is acked*/
+    Duration m_lastRoundMinRtt{ Duration::Infinite() };
+    Duration m_currRoundMinRtt{ Duration::Infinite() };
+    uint32_t m_rttSampleCnt{ 0 };
+    bool m_inCss{ false };/** in conservative slow start*/
+    Duration m_cssBaselineMinRtt{ Duration::Infinite() };
+    uint32_t m_cssRounds{ 0 };
+};
+
+/// the increase rule of CoupledCongestionCtrl
+enum class CoupledIncreaseAlgo : uint8_t
+{
+    lia = 0,/** RFC 6356*/
+    olia,/** Khalili et al., "MPTCP is not Pareto-optimal", CoNEXT 2012*/
+    balia,/** Peng et al., "Multipath TCP: analysis, design and implementation", ToN 2016*/
+};
+
+/// tunables of CoupledCongestionCtrl, the window bounds come from RenoCongestionCtlConfig
+struct CoupledCongestionCtlConfig
+{
+    uint32_t initCwnd{ 10 };
+    CoupledIncreaseAlgo algo{ CoupledIncreaseAlgo::lia };
+
+    static const char* AlgoName(CoupledIncreaseAlgo algo);
+
+    /// @return false if no algo is named name
+    static bool AlgoFromName(const std::string& name, CoupledIncreaseAlgo& algo);
+};
+
+class CoupledCongestionCtrl;
+
+/// The sessions whose windows are coupled, they are assumed to share one bottleneck.
+/// The group is owned by the transport controller, each member joins on creation and leaves on destruction.
+/// Groups are small, one member per upnode, so the coupled terms are summed over the members on every ack.
+class CoupledCongestionCtlGroup
+{
+public:
+    void Join(CoupledCongestionCtrl* member);
+
+    void Leave(CoupledCongestionCtrl* member);
+
+    size_t size() const
+    {
+        return m_members.size();
+    }
+
+    /// cwnd increase of member for one acked piece in congestion avoidance
+    double IncreaseOnAck(const CoupledCongestionCtrl& member, CoupledIncreaseAlgo algo) const;
+
+    /// the fraction of its cwnd that member gives up on a loss event
+    double DecreaseOnLoss(const CoupledCongestionCtrl& member, CoupledIncreaseAlgo algo) const;
+
+private:
+    double LiaIncrease(const CoupledCongestionCtrl& member) const;
+    double OliaIncrease(const CoupledCongestionCtrl& member) const;
+    double BaliaIncrease(const CoupledCongestionCtrl& member) const;
+
+    std::vector<CoupledCongestionCtrl*> m_members;
+};
+
+/// Window based congestion control coupled across the sessions of a CoupledCongestionCtlGroup.
+/// Slow start and loss response are per session, the congestion avoidance increase is coupled so that all the
+/// sessions together take no more of the shared bottleneck than one Reno flow, while the window moves towards the
+/// sessions with less loss and lower RTT.
+class CoupledCongestionCtrl : public CongestionCtlAlgo
+{
+public:
+    CoupledCongestionCtrl(const RenoCongestionCtlConfig& wndConfig, const CoupledCongestionCtlConfig& ccConfig,
+            std::shared_ptr<CoupledCongestionCtlGroup> group);
+    ~CoupledCongestionCtrl() override;
+    CongestionCtlType GetCCtype() override;
+    void OnDataSent(const InflightPacket& sentpkt) override;
+    void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override;
+    void OnSpuriousLoss(const InflightPacket& lostpkt) override;
+    uint32_t GetCWND() override;
+    void SetCoupledGroup(std::shared_ptr<CoupledCongestionCtlGroup> group) override;
+
+    /// state read by the group
+    double Cwnd() const
+    {
+        return m_cwnd;
+    }
+
+    /// smoothed RTT in seconds
+    double Rtt() const
+    {
+        return m_rtt;
+    }
+
+    /// pieces acked between the last two loss events and since the last one, for OLIA
+    double InterLossPieces() const
+    {
+        return std::max(m_ackedBetweenLosses, m_ackedSinceLoss);
+    }
+
+private:
+    void OnDataRecv(const AckEvent& ackEvent, Timepoint now, RttStats& rttstats);
+    void OnDataLoss(const LossEvent& lossEvent, Timepoint now);
+    double BoundCwnd(double trySetCwnd) const;
+    bool InSlowStart() const;
+
+    std::shared_ptr<CoupledCongestionCtlGroup> m_group;
+    CoupledIncreaseAlgo m_algo{ CoupledIncreaseAlgo::lia };
+    double m_minCwnd{ 1 };
+    double m_maxCwnd{ 64 };
+    double m_cwnd{ 10 };/** fractional, GetCWND rounds down*/
+    double m_ssThresh{ 0 };/** 0 until the first loss*/
+    double m_rtt{ 0.1 };/** seconds*/
+    double m_ackedSinceLoss{ 0 };
+    double m_ackedBetweenLosses{ 0 };
+    Timepoint m_recoveryStart{ Timepoint::Zero() };/** losses of requests sent before this are in the same event*/
+    uint32_t m_id{ 0 };
+
+    /// state before the last reduction, restored if it is found spurious
+    bool m_undoValid{ false };
+    double m_undoCwnd{ 0 };
+    double m_undoSsThresh{ 0 };
+    SeqNumber m_undoMinLostSeq{ MAX_SEQNUMBER };
+    SeqNumber m_undoMaxLostSeq{ 0 };
+};
+
+/// everything needed to create the congestion control algo of a session: the algo type, the window bounds shared
+/// by all algos and the typed parameter block of each algo
+struct CongestionCtlConfig
+{
+    CongestionCtlType type{ CongestionCtlType::test };
+    RenoCongestionCtlConfig reno;/** window bounds, and the parameters of reno*/
+    BBRCongestionCtlConfig bbr;
+    CubicCongestionCtlConfig cubic;
+    CoupledCongestionCtlConfig coupled;
+    std::shared_ptr<CoupledCongestionCtlGroup> coupledGroup;/** set by the transport controller, coupled cc only*/
+
+    std::string DebugInfo() const;
+};
+
+/// Registry of congestion control algos keyed by CongestionCtlType, the built in algos are registered on creation.
+class CongestionCtlFactory
+{
+public:
+    using Creator = std::function<std::unique_ptr<CongestionCtlAlgo>(const CongestionCtlConfig& ccConfig)>;
+
+    static CongestionCtlFactory& Instance();
+
+    /// register or replace the creator of type
+    void Register(CongestionCtlType type, Creator creator);
+
+    /// @return null if type is not registered
+    std::unique_ptr<CongestionCtlAlgo> Create(const CongestionCtlConfig& ccConfig) const;
+
+    static const char* TypeName(CongestionCtlType type);
+
+    /// @return false if no registered type is named name
+    bool TypeFromName(const std::string& name, CongestionCtlType& type) const;
+
+private:
+    CongestionCtlFactory();
+
+    std::map<CongestionCtlType, Creator> m_creators;
+};
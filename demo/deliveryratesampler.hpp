@@ -0,0 +1,170 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "packettype.h"
+
+/// one delivery rate sample, produced by the ack of a request
+struct RateSample
+{
+    bool valid{ false };/** the acked request was tracked, priorDelivered is meaningful*/
+    SeqNumber seq{ MAX_SEQNUMBER };/** the acked request*/
+    uint64_t priorDelivered{ 0 };/** pieces delivered when the acked request was sent*/
+    uint64_t delivered{ 0 };/** pieces delivered over the sample interval*/
+    Duration interval{ Duration::Zero() };/** zero if shorter than a round trip, then there is no rate*/
+    double deliveryRate{ 0 };/** pieces per second, 0 if interval is zero*/
+    bool appLimited{ false };/** the session ran out of pieces to request during the interval*/
+    bool roundStart{ false };/** the ack ended a round trip*/
+};
+
+/** Delivery rate estimation, draft-cheng-iccrg-delivery-rate-estimation, as Linux tcp_rate.c does it.
+ *  The delivered count and time are snapshotted when each request is sent. Its ack yields the pieces delivered
+ *  since, over the longer of the send and ack intervals, so that neither a burst of requests nor a compressed
+ *  burst of replies inflates the rate. A sample taken while the scheduler had no piece to request is flagged
+ *  app-limited: it only says the path can go at least that fast.
+ * */
+class DeliveryRateSampler
+{
+public:
+    void OnPacketSent(SeqNumber seq, Timepoint sendtic)
+    {
+        if (m_sendStates.empty())
+        {
+            // nothing in flight, don't let the idle time into the next rate sample
+            m_firstSentTic = sendtic;
+            m_deliveredTic = sendtic;
+        }
+        SendState state;
+        state.delivered = m_delivered;
+        state.deliveredTic = m_deliveredTic;
+        state.firstSentTic = m_firstSentTic;
+        state.sendtic = sendtic;
+        state.appLimited = m_appLimitedUntil != 0;
+        m_sendStates.Insert(seq, state);
+    }
+
+    /// the ack of seq arrived at now, @return false if seq isn't tracked, no sample then
+    bool OnPacketAcked(SeqNumber seq, Timepoint now, Duration minRtt)
+    {
+        const SendState* found = m_sendStates.Find(seq);
+        if (!found)
+        {
+            return false;
+        }
+        SendState state = *found;
+        m_sendStates.Erase(seq);
+
+        ++m_delivered;
+        m_deliveredTic = now;
+        bool roundStart = state.delivered >= m_nextRoundDelivered;
+        if (roundStart)
+        {
+            // a request sent after the previous round ended is acked
+            m_nextRoundDelivered = m_delivered;
+            ++m_roundCnt;
+        }
+        if (m_appLimitedUntil != 0 && m_delivered > m_appLimitedUntil)
+        {
+            // the pieces in flight when the session went app-limited are all delivered
+            m_appLimitedUntil = 0;
+        }
+
+        m_latest = RateSample();
+        m_latest.valid = true;
+        m_latest.seq = seq;
+        m_latest.priorDelivered = state.delivered;
+        m_latest.delivered = m_delivered - state.delivered;
+        m_latest.appLimited = state.appLimited;
+        m_latest.roundStart = roundStart;
+        Duration sendElapsed = state.sendtic - state.firstSentTic;
+        Duration ackElapsed = now - state.deliveredTic;
+        Duration interval = std::max(sendElapsed, ackElapsed);
+        m_firstSentTic = state.sendtic;
+        if (interval <= Duration::Zero() || (minRtt > Duration::Zero() && interval < minRtt))
+        {
+            // shorter than a round trip, can't tell the bottleneck rate
+            return true;
+        }
+        m_latest.interval = interval;
+        m_latest.deliveryRate = m_latest.delivered * 1000000.0 / interval.ToMicroseconds();
+        if (!m_latest.appLimited || m_latest.deliveryRate > m_lastRate)
+        {
+            // an app-limited sample only counts if it beats the estimate
+            m_lastRate = m_latest.deliveryRate;
+        }
+        SPDLOG_TRACE("seq:{} delivery rate:{} appLimited:{}", seq, m_latest.deliveryRate, m_latest.appLimited);
+        return true;
+    }
+
+    /// lost requests are out of flight and deliver nothing
+    void OnPacketLost(SeqNumber seq)
+    {
+        m_sendStates.Erase(seq);
+    }
+
+    /// the scheduler had window to fill but no piece to request
+    void OnAppLimited()
+    {
+        // the samples stay app-limited until the pieces in flight now have been delivered
+        m_appLimitedUntil = std::max<uint64_t>(m_delivered + m_sendStates.size(), 1);
+    }
+
+    bool IsAppLimited() const
+    {
+        return m_appLimitedUntil != 0;
+    }
+
+    /// the sample of the latest ack
+    const RateSample& LatestSample() const
+    {
+        return m_latest;
+    }
+
+    /// pieces per second of the latest sample with a rate, app-limited ones only if they were higher
+    double GetDeliveryRate() const
+    {
+        return m_lastRate;
+    }
+
+    uint64_t GetDelivered() const
+    {
+        return m_delivered;
+    }
+
+    /// round trips so far
+    uint64_t GetRoundCnt() const
+    {
+        return m_roundCnt;
+    }
+
+    /// requests sent and neither acked nor lost
+    size_t GetTrackedCnt() const
+    {
+        return m_sendStates.size();
+    }
+
+private:
+    /// session delivery state when a request is sent
+    struct SendState
+    {
+        uint64_t delivered{ 0 };
+        Timepoint deliveredTic{ Timepoint::Zero() };
+        Timepoint firstSentTic{ Timepoint::Zero() };
+        Timepoint sendtic{ Timepoint::Zero() };
+        bool appLimited{ false };
+    };
+
+    SeqIndexedRing<SendState> m_sendStates;/** requests in flight*/
+    uint64_t m_delivered{ 0 };/** pieces delivered so far*/
+    Timepoint m_deliveredTic{ Timepoint::Zero() };
+    Timepoint m_firstSentTic{ Timepoint::Zero() };
+    uint64_t m_roundCnt{ 0 };
+    uint64_t m_nextRoundDelivered{ 0 };
+    uint64_t m_appLimitedUntil{ 0 };/** app-limited until m_delivered passes this, 0 if not*/
+    RateSample m_latest;
+    double m_lastRate{ 0 };
+};
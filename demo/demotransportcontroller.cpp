@@ -7,13 +7,201 @@ DemoTransportCtlConfig::DemoTransportCtlConfig() : TransPortControllerConfig()
 }
 
 
+CongestionCtlConfig DemoTransportCtlConfig::GetCongestionCtlConfig(const basefw::ID& upnode) const
+{
+    auto&& itor = upnodeCcConfigs.find(upnode);
+    if (itor != upnodeCcConfigs.end())
+    {
+        return itor->second;
+    }
+    return GetDefaultCongestionCtlConfig();
+}
+
+CongestionCtlConfig DemoTransportCtlConfig::GetDefaultCongestionCtlConfig() const
+{
+    CongestionCtlConfig ccConfig;
+    ccConfig.type = ccType;
+    ccConfig.reno.minCwnd = minWnd;
+    ccConfig.reno.maxCwnd = maxWnd;
+    ccConfig.reno.ssThresh = slowStartThreshold;
+    ccConfig.bbr = bbrConfig;
+    ccConfig.cubic = cubicConfig;
+    ccConfig.coupled = coupledConfig;
+    return ccConfig;
+}
+
+/// assign j[key] to val if j has key, throw json::exception if the value doesn't fit
+template <typename T>
+static void OverlayJsonValue(const json& j, const char* key, T& val)
+{
+    auto&& itor = j.find(key);
+    if (itor != j.end())
+    {
+        itor->get_to(val);
+    }
+}
+
+static void OverlayCongestionCtlJson(const json& j, CongestionCtlConfig& ccConfig)
+{
+    auto&& typeItor = j.find("type");
+    if (typeItor != j.end())
+    {
+        auto typeName = typeItor->get<std::string>();
+        if (!CongestionCtlFactory::Instance().TypeFromName(typeName, ccConfig.type))
+        {
+            throw std::invalid_argument("unknown congestion control type " + typeName);
+        }
+    }
+    OverlayJsonValue(j, "minWnd", ccConfig.reno.minCwnd);
+    OverlayJsonValue(j, "maxWnd", ccConfig.reno.maxCwnd);
+    OverlayJsonValue(j, "slowStartThreshold", ccConfig.reno.ssThresh);
+    auto&& bbrItor = j.find("bbr");
+    if (bbrItor != j.end())
+    {
+        OverlayJsonValue(*bbrItor, "initCwnd", ccConfig.bbr.initCwnd);
+        OverlayJsonValue(*bbrItor, "cwndGain", ccConfig.bbr.cwndGain);
+        OverlayJsonValue(*bbrItor, "minRttWindowMs", ccConfig.bbr.minRttWindowMs);
+        OverlayJsonValue(*bbrItor, "probeRttDurationMs", ccConfig.bbr.probeRttDurationMs);
+    }
+    auto&& cubicItor = j.find("cubic");
+    if (cubicItor != j.end())
+    {
+        OverlayJsonValue(*cubicItor, "initCwnd", ccConfig.cubic.initCwnd);
+        OverlayJsonValue(*cubicItor, "c", ccConfig.cubic.c);
+        OverlayJsonValue(*cubicItor, "beta", ccConfig.cubic.beta);
+        OverlayJsonValue(*cubicItor, "hyStart", ccConfig.cubic.hyStart);
+    }
+    auto&& coupledItor = j.find("coupled");
+    if (coupledItor != j.end())
+    {
+        OverlayJsonValue(*coupledItor, "initCwnd", ccConfig.coupled.initCwnd);
+        auto&& algoItor = coupledItor->find("algo");
+        if (algoItor != coupledItor->end())
+        {
+            auto algoName = algoItor->get<std::string>();
+            if (!CoupledCongestionCtlConfig::AlgoFromName(algoName, ccConfig.coupled.algo))
+            {
+                throw std::invalid_argument("unknown coupled congestion control algo " + algoName);
+            }
+        }
+    }
+}
+
+bool DemoTransportCtlConfig::ParseCongestionCtlJson(const json& downnode)
+{
+    try
+    {
+        auto&& ccItor = downnode.find("congestionControl");
+        if (ccItor != downnode.end())
+        {
+            CongestionCtlConfig ccConfig = GetDefaultCongestionCtlConfig();
+            OverlayCongestionCtlJson(*ccItor, ccConfig);
+            ccType = ccConfig.type;
+            minWnd = ccConfig.reno.minCwnd;
+            maxWnd = ccConfig.reno.maxCwnd;
+            slowStartThreshold = ccConfig.reno.ssThresh;
+            bbrConfig = ccConfig.bbr;
+            cubicConfig = ccConfig.cubic;
+            coupledConfig = ccConfig.coupled;
+            auto&& pacerItor = ccItor->find("pacer");
+            if (pacerItor != ccItor->end())
+            {
+                OverlayJsonValue(*pacerItor, "burst", pacerConfig.burst);
+                OverlayJsonValue(*pacerItor, "pacingGain", pacerConfig.pacingGain);
+            }
+            auto&& wndCapItor = ccItor->find("windowCap");
+            if (wndCapItor != ccItor->end())
+            {
+                OverlayJsonValue(*wndCapItor, "initWnd", wndCapConfig.initWnd);
+                OverlayJsonValue(*wndCapItor, "minWnd", wndCapConfig.minWnd);
+                OverlayJsonValue(*wndCapItor, "bdpGain", wndCapConfig.bdpGain);
+                OverlayJsonValue(*wndCapItor, "memoryBudgetKB", memoryBudgetKB);
+                if (wndCapConfig.bdpGain < 1)
+                {
+                    throw std::invalid_argument("windowCap bdpGain must be at least 1");
+                }
+            }
+        }
+        auto&& upnodesItor = downnode.find("upnodes");
+        if (upnodesItor == downnode.end())
+        {
+            return true;
+        }
+        for (auto&& upnode: *upnodesItor)
+        {
+            auto&& upccItor = upnode.find("congestionControl");
+            if (upccItor == upnode.end())
+            {
+                continue;
+            }
+            basefw::ID upnodeId(upnode.at("selfpeerID").get<std::string>());
+            CongestionCtlConfig ccConfig = GetCongestionCtlConfig(upnodeId);
+            OverlayCongestionCtlJson(*upccItor, ccConfig);
+            upnodeCcConfigs[upnodeId] = ccConfig;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_ERROR("bad congestionControl config: {}", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool DemoTransportCtlConfig::ParseMultiPathSchedulerJson(const json& downnode)
+{
+    try
+    {
+        auto&& schedulerItor = downnode.find("multipathScheduler");
+        if (schedulerItor == downnode.end())
+        {
+            return true;
+        }
+        auto&& typeItor = schedulerItor->find("type");
+        if (typeItor != schedulerItor->end())
+        {
+            auto typeName = typeItor->get<std::string>();
+            if (!MultiPathSchedulerTypeFromName(typeName, schedulerType))
+            {
+                throw std::invalid_argument("unknown multipath scheduler type " + typeName);
+            }
+        }
+        auto&& dupBudgetItor = schedulerItor->find("dupBudget");
+        if (dupBudgetItor != schedulerItor->end())
+        {
+            auto budget = dupBudgetItor->get<double>();
+            if (budget < 0 || budget >= 1)
+            {
+                throw std::invalid_argument("dupBudget must be in [0, 1)");
+            }
+            dupBudget = budget;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_ERROR("bad multipathScheduler config: {}", e.what());
+        return false;
+    }
+    return true;
+}
+
 std::string DemoTransportCtlConfig::DebugInfo()
 {
     std::stringstream ss;
     ss
             << "{"
             << "minWnd:" << minWnd << " maxWnd:" << maxWnd << " slowStartThreshold:" << slowStartThreshold
-            << " }";
+            << " lossTimerGranularityMs:" << lossTimerGranularityMs << " alarmIntervalMs:" << alarmIntervalMs
+            << " pacerBurst:" << pacerConfig.burst << " pacingGain:" << pacerConfig.pacingGain
+            << " initWnd:" << wndCapConfig.initWnd << " minCapWnd:" << wndCapConfig.minWnd
+            << " bdpGain:" << wndCapConfig.bdpGain << " memoryBudgetKB:" << memoryBudgetKB
+            << " scheduler:" << schedulerType << " dupBudget:" << dupBudget
+            << " cc:" << GetDefaultCongestionCtlConfig().DebugInfo();
+    for (auto&& upnode_cc: upnodeCcConfigs)
+    {
+        ss << " upnode " << upnode_cc.first.ToLogStr() << " cc:" << upnode_cc.second.DebugInfo();
+    }
+    ss << " }";
     return ss.str();
 }
 
@@ -23,9 +211,9 @@ DemoTransportCtl::DemoTransportCtl(std::shared_ptr<TransPortControllerConfig> ct
 {
     //multipathscheduler = std::make_shared(RRMultiPathScheduler());
     m_transCtlConfig = std::dynamic_pointer_cast<DemoTransportCtlConfig>(ctlConfig);
-    renoccConfig.minCwnd = m_transCtlConfig->minWnd;
-    renoccConfig.maxCwnd = m_transCtlConfig->maxWnd;
-    renoccConfig.ssThresh = m_transCtlConfig->slowStartThreshold;
+    m_lossTimerWheel.reset(new TimerWheel<LossTimerKey>(Clock::GetClock()->Now(),
+            Duration::FromMilliseconds(m_transCtlConfig->lossTimerGranularityMs)));
+    m_coupledCcGroup = std::make_shared<CoupledCongestionCtlGroup>();
     SPDLOG_DEBUG("config:{}", m_transCtlConfig->DebugInfo());
 }
 
@@ -58,9 +246,24 @@ bool DemoTransportCtl::StartTransportController(TransportDownloadTaskInfo tansDl
     SPDLOG_DEBUG("taskid: {}", tansDlTkInfo.m_rid.ToLogStr());
 
     m_transctlHandler = transCtlHandler;
+    m_tansDlTkInfo = tansDlTkInfo;
 
-    m_multipathscheduler.reset(
-            new RRMultiPathScheduler(m_tansDlTkInfo.m_rid, m_sessStreamCtlMap, m_downloadPieces, m_lostPiecesl));
+    if (m_transCtlConfig->schedulerType == MULTI_PATH_SCHEDULE_EDF)
+    {
+        m_multipathscheduler.reset(
+                new EDFMultiPathScheduler(m_tansDlTkInfo.m_rid, m_sessStreamCtlMap, m_downloadPieces, m_lostPiecesl,
+                        m_transCtlConfig->dupBudget));
+    }
+    else if (m_transCtlConfig->schedulerType == MULTI_PATH_SCHEDULE_ECT)
+    {
+        m_multipathscheduler.reset(
+                new ECTMultiPathScheduler(m_tansDlTkInfo.m_rid, m_sessStreamCtlMap, m_downloadPieces, m_lostPiecesl));
+    }
+    else
+    {
+        m_multipathscheduler.reset(
+                new RRMultiPathScheduler(m_tansDlTkInfo.m_rid, m_sessStreamCtlMap, m_downloadPieces, m_lostPiecesl));
+    }
     m_multipathscheduler->StartMultiPathScheduler(shared_from_this());
     return true;
 }
@@ -75,6 +278,7 @@ void DemoTransportCtl::StopTransportController()
         return;
     }
     isRunning = false;
+    DEMO_TRACE_DUMP();
     // todo:
     if (m_multipathscheduler)
     {
@@ -111,8 +315,13 @@ void DemoTransportCtl::OnSessionCreate(const fw::ID& sessionid)
     auto&& sessionItor = m_sessStreamCtlMap.find(sessionid);
     if (sessionItor == m_sessStreamCtlMap.end())
     {
+        CongestionCtlConfig ccConfig = m_transCtlConfig->GetCongestionCtlConfig(sessionid);
+        // until the bottleneck detector has enough samples, assume all upnodes sit behind the same bottleneck
+        ccConfig.coupledGroup = m_coupledCcGroup;
         m_sessStreamCtlMap[sessionid] = std::make_shared<SessionStreamController>();
-        m_sessStreamCtlMap[sessionid]->StartSessionStreamCtl(sessionid, renoccConfig, shared_from_this());
+        m_sessStreamCtlMap[sessionid]->StartSessionStreamCtl(sessionid, ccConfig, m_transCtlConfig->pacerConfig,
+                m_transCtlConfig->wndCapConfig, shared_from_this());
+        ShareWindowBudget();
     }
     else
     {
@@ -161,6 +370,11 @@ void DemoTransportCtl::OnSessionDestory(const fw::ID& sessionid)
         m_sessStreamCtlMap[sessionid]->StopSessionStreamCtl();
         m_sessStreamCtlMap[sessionid].reset();
     }
+    if (m_bottleneckDetector.RemoveSession(sessionid))
+    {
+        ApplyBottleneckGroups();
+    }
+    ShareWindowBudget();
 
 }
 
@@ -170,16 +384,22 @@ void DemoTransportCtl::OnSessionDestory(const fw::ID& sessionid)
  */
 void DemoTransportCtl::OnPieceTaskAdding(std::vector<int32_t>& datapiecesVec)
 {
-    for (auto&& dataPiece: datapiecesVec)
+    // the pieces come in ascending runs, each is added a word of the bitmap at a time
+    for (size_t first = 0; first < datapiecesVec.size();)
     {
-        auto rt = m_downloadPieces.emplace(dataPiece);
-        if (!rt.second)
+        size_t last = first;
+        while (last + 1 < datapiecesVec.size() && datapiecesVec[last + 1] == datapiecesVec[last] + 1)
+        {
+            ++last;
+        }
+        if (m_downloadPieces.InsertRange(datapiecesVec[first], datapiecesVec[last]) < last - first + 1)
         {
             // warning: already has
         }
+        first = last + 1;
     }
-    // Do multipath schedule after new tasks added
-    m_multipathscheduler->DoMultiPathSchedule();
+    // the scheduler decides whether the new tasks can be sent now
+    m_multipathscheduler->OnTasksAdded(static_cast<uint32_t>(datapiecesVec.size()));
 }
 
 /**@brief the download task is started now.
@@ -229,8 +449,11 @@ void DemoTransportCtl::OnDataPiecesReceived(const fw::ID& sessionid, uint32_t se
         //warn: received on an unknown session
         SPDLOG_WARN("received on an unknown session {}", sessionid.ToLogStr());
     }
+    // packets sent before this one may have expired in the meantime
+    PollLossTimers(Clock::GetClock()->Now());
     // inform multipath scheduler
     m_multipathscheduler->OnReceiveSubpieceData(sessionid, seq, datapiece, recvtic);
+    PollScheduleTimer(Clock::GetClock()->Now());
 }
 
 /**
@@ -267,13 +490,13 @@ void DemoTransportCtl::OnDataSent(const fw::ID& sessionid, const std::vector<int
 void DemoTransportCtl::OnLossDetectionAlarm()
 {
     SPDLOG_TRACE("DemoTransportCtl::OnLossDetectionAlarm()");
-    // Step 1: Check loss in each session
-    for (auto&& sessStreamItor: m_sessStreamCtlMap)
-    {
-        sessStreamItor.second->OnLossDetectionAlarm();
-    }
+    // Step 1: Check loss in the sessions whose loss timers are due
+    PollLossTimers(Clock::GetClock()->Now());
+    CheckBottleneckGroups(Clock::GetClock()->Now());
+    ShareWindowBudget();
     // Step 2: Forward message to Multipath Scheduler
-    m_multipathscheduler->DoMultiPathSchedule();
+    PollScheduleTimer(Clock::GetClock()->Now());
+    m_multipathscheduler->OnScheduleAlarm();
 }
 
 // session stream handler
@@ -285,10 +508,31 @@ void DemoTransportCtl::OnPiecePktTimeout(const basefw::ID& peerid, const std::ve
         return;
     }
 
+    m_bottleneckDetector.OnLoss(peerid, spns.size());
     m_multipathscheduler->OnTimedOut(peerid, spns);
 
 }
 
+void DemoTransportCtl::OnPiecePktSpuriousLoss(const basefw::ID& peerid, int32_t spn)
+{
+    if (!isRunning)
+    {
+        return;
+    }
+
+    m_multipathscheduler->OnSpuriousLoss(peerid, spn);
+}
+
+void DemoTransportCtl::OnRttSample(const basefw::ID& peerid, Duration rtt, Timepoint recvtic)
+{
+    if (!isRunning)
+    {
+        return;
+    }
+    CheckBottleneckGroups(Clock::GetClock()->Now());
+    m_bottleneckDetector.OnDelaySample(peerid, rtt, recvtic);
+}
+
 bool DemoTransportCtl::DoSendDataRequest(const basefw::ID& peerid, const std::vector<int32_t>& spns)
 {
     SPDLOG_TRACE("peerid = {}, spns= {}", peerid.ToLogStr(), spns);
@@ -305,7 +549,12 @@ bool DemoTransportCtl::DoSendDataRequest(const basefw::ID& peerid, const std::ve
     auto handler = m_transctlHandler.lock();
     if (handler)
     {
-        return handler->DoSendDataRequest(peerid, spns);
+        bool rt = handler->DoSendDataRequest(peerid, spns);
+        if (rt && !m_firstRequestTic.IsInitialized())
+        {
+            m_firstRequestTic = Clock::GetClock()->Now();
+        }
+        return rt;
     }
     else
     {
@@ -315,23 +564,160 @@ bool DemoTransportCtl::DoSendDataRequest(const basefw::ID& peerid, const std::ve
 
 }
 
+uint64_t DemoTransportCtl::ArmLossTimer(const basefw::ID& peerid, SeqNumber seq, Timepoint deadline)
+{
+    LossTimerKey key;
+    key.sessionid = peerid;
+    key.seq = seq;
+    return m_lossTimerWheel->Schedule(deadline, key);
+}
+
+void DemoTransportCtl::CancelLossTimer(uint64_t timerid)
+{
+    m_lossTimerWheel->Cancel(timerid);
+}
+
+void DemoTransportCtl::PollLossTimers(Timepoint now)
+{
+    // collect first, sessions cancel and re-arm timers while handling them
+    std::unordered_map<basefw::ID, std::vector<SeqNumber>> expiredSeqs;
+    m_lossTimerWheel->Advance(now, [&expiredSeqs](const LossTimerKey& key)
+    {
+        expiredSeqs[key.sessionid].emplace_back(key.seq);
+    });
+    for (auto&& id_seqs: expiredSeqs)
+    {
+        auto&& sessStreamItor = m_sessStreamCtlMap.find(id_seqs.first);
+        if (sessStreamItor != m_sessStreamCtlMap.end() && sessStreamItor->second)
+        {
+            sessStreamItor->second->OnLossTimerExpired(id_seqs.second);
+        }
+        else
+        {
+            SPDLOG_DEBUG("loss timers fired on a destroyed session {}", id_seqs.first.ToLogStr());
+        }
+    }
+}
+
+void DemoTransportCtl::PollScheduleTimer(Timepoint now)
+{
+    if (!m_scheduleTimerTic.IsInitialized() || now < m_scheduleTimerTic)
+    {
+        return;
+    }
+    m_scheduleTimerTic = Timepoint::Zero();
+    m_multipathscheduler->OnScheduleTimer();
+}
+
+void DemoTransportCtl::CheckBottleneckGroups(Timepoint now)
+{
+    if (m_bottleneckDetector.OnTimeElapsed(now))
+    {
+        ApplyBottleneckGroups();
+    }
+}
+
+void DemoTransportCtl::ApplyBottleneckGroups()
+{
+    const auto& groups = m_bottleneckDetector.GetGroups();
+    for (auto&& group: groups)
+    {
+        // a session alone in its group is on an independent path and no longer held back by the others
+        auto ccGroup = std::make_shared<CoupledCongestionCtlGroup>();
+        for (auto&& sessionid: group)
+        {
+            auto&& sessStreamItor = m_sessStreamCtlMap.find(sessionid);
+            if (sessStreamItor != m_sessStreamCtlMap.end() && sessStreamItor->second)
+            {
+                sessStreamItor->second->SetCoupledGroup(ccGroup);
+            }
+        }
+        SPDLOG_DEBUG("bottleneck group of {} sessions", group.size());
+    }
+    if (m_multipathscheduler)
+    {
+        m_multipathscheduler->OnBottleneckGroupsChanged(groups);
+    }
+}
+
+void DemoTransportCtl::ShareWindowBudget()
+{
+    uint64_t budget = m_transCtlConfig->memoryBudgetKB;
+    uint64_t totalCap = 0;
+    size_t sessCnt = 0;
+    for (auto&& id_sess: m_sessStreamCtlMap)
+    {
+        if (id_sess.second)
+        {
+            totalCap += id_sess.second->GetWindowCap();
+            ++sessCnt;
+        }
+    }
+    if (sessCnt == 0)
+    {
+        return;
+    }
+    // under the budget each session may grow its cap by an even part of the rest, over it the caps are scaled down
+    for (auto&& id_sess: m_sessStreamCtlMap)
+    {
+        if (!id_sess.second)
+        {
+            continue;
+        }
+        uint64_t cap = id_sess.second->GetWindowCap();
+        uint64_t share = totalCap <= budget ? cap + (budget - totalCap) / sessCnt : cap * budget / totalCap;
+        id_sess.second->SetWindowBudget(static_cast<uint32_t>(std::min<uint64_t>(share, UINT32_MAX)));
+    }
+}
+
 //Multipath scheduler handlers
 
 bool DemoTransportCtl::OnGetCurrPlayPos(uint64_t& currplaypos)
 {
     // curr play pos in Byte
-    return false;
+    auto&& progress = m_transCtlConfig->playProgress;
+    if (progress && progress->playing)
+    {
+        currplaypos = progress->playPos;
+        return true;
+    }
+    // until the player reports, assume it plays from the first request on, as the download is scored
+    uint32_t byterate = 0;
+    if (!m_firstRequestTic.IsInitialized() || !OnGetByteRate(byterate))
+    {
+        return false;
+    }
+    Duration elapsed = Clock::GetClock()->Now() - m_firstRequestTic;
+    currplaypos = static_cast<uint64_t>(elapsed.ToMicroseconds()) * byterate / 1000000;
+    return true;
 }
 
 bool DemoTransportCtl::OnGetCurrCachePos(uint64_t& currcachepos)
 {
-    return false;
+    auto&& progress = m_transCtlConfig->playProgress;
+    if (!progress)
+    {
+        return false;
+    }
+    currcachepos = progress->cachePos;
+    return true;
 
 }
 
 bool DemoTransportCtl::OnGetByteRate(uint32_t& playbyterate)
 {
     // bytes per second
+    if (m_tansDlTkInfo.m_byterate > 0 && m_tansDlTkInfo.m_byterate != std::numeric_limits<uint32_t>::max())
+    {
+        playbyterate = m_tansDlTkInfo.m_byterate;
+        return true;
+    }
+    auto&& progress = m_transCtlConfig->playProgress;
+    if (progress && progress->byterate > 0)
+    {
+        playbyterate = progress->byterate;
+        return true;
+    }
     return false;
 }
 
@@ -353,6 +739,21 @@ void DemoTransportCtl::OnRequestDownloadPieces(uint32_t maxpiececnt)
     }
 }
 
+/// the transport controller has no timer of its own, the deadline is polled on each packet received and on the alarm
+void DemoTransportCtl::ArmScheduleTimer(Timepoint deadline)
+{
+    if (!m_scheduleTimerTic.IsInitialized() || deadline < m_scheduleTimerTic)
+    {
+        m_scheduleTimerTic = deadline;
+    }
+}
+
+uint32_t DemoTransportModuleSettings::GetAlarmInterval()
+{
+    auto demoConfig = std::dynamic_pointer_cast<DemoTransportCtlConfig>(transportCtlConfig);
+    return demoConfig ? demoConfig->alarmIntervalMs : TransportModuleSettings::GetAlarmInterval();
+}
+
 std::shared_ptr<MPDTransportController>
 DemoTransportCtlFactory::MakeTransportController(std::shared_ptr<TransPortControllerConfig> ctlConfig)
 {
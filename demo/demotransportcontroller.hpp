@@ -3,13 +3,27 @@
 
 #pragma once
 
+#include <atomic>
 #include "mpd/download/transportcontroller/transportcontroller.hpp"
 #include "multipathschedulerI.h"
 #include "congestioncontrol.hpp"
 #include "sessionstreamcontroller.hpp"
 #include "rrmultipathscheduler.hpp"
+#include "ectmultipathscheduler.hpp"
+#include "edfmultipathscheduler.hpp"
+#include "sharedbottleneckdetector.hpp"
+#include "utils/timerwheel.hpp"
 
 
+/// play progress reported by the player, e.g. from PlayerEventHandler::OnPlayPosUpdate and OnPlayCacheUpdate
+struct PlayProgress
+{
+    std::atomic<bool> playing{ false };/** playPos has been reported*/
+    std::atomic<uint64_t> playPos{ 0 };/** bytes*/
+    std::atomic<uint64_t> cachePos{ 0 };/** bytes cached from the start of the file without a gap*/
+    std::atomic<uint32_t> byterate{ 0 };/** bytes per second of the play task, 0 if unknown*/
+};
+
 struct DemoTransportCtlConfig : public TransPortControllerConfig
 {
 public:
@@ -17,9 +31,44 @@ public:
 
     ~DemoTransportCtlConfig() override = default;
 
-    uint32_t maxWnd{ 64 };
+    uint32_t maxWnd{ 1024 };/** ceiling of the cc window, the window used is capped per session by wndCapConfig*/
     uint32_t minWnd{ 1 };
     uint32_t slowStartThreshold{ 32 };
+    uint32_t lossTimerGranularityMs{ 5 };/** tick of the per-packet loss timer wheel*/
+    uint32_t alarmIntervalMs{ 20 };/** period of OnLossDetectionAlarm, see DemoTransportModuleSettings*/
+    CongestionCtlType ccType{ CongestionCtlType::test };/** congestion control algo of the sessions*/
+    BBRCongestionCtlConfig bbrConfig;
+    CubicCongestionCtlConfig cubicConfig;
+    CoupledCongestionCtlConfig coupledConfig;
+    std::map<basefw::ID, CongestionCtlConfig> upnodeCcConfigs;/** per upnode overrides, keyed by upnode peer id*/
+    PacerConfig pacerConfig;/** token bucket pacer of the sessions*/
+    WindowCapConfig wndCapConfig;/** bandwidth-delay product cap of the session windows*/
+    uint32_t memoryBudgetKB{ 4096 };/** pieces of 1KB the sessions of the task may have in flight together*/
+    MultiPathSchedulerType schedulerType{ MULTI_PATH_SCHEDULE_RR };/** how pieces are spread over the sessions*/
+    double dupBudget{ 0.02 };/** share of the requested bytes the edf scheduler may request twice, 0 never does*/
+    std::shared_ptr<PlayProgress> playProgress;/** updated by the app, null if it doesn't report the player*/
+
+    /// the congestion control config made of the fields above
+    CongestionCtlConfig GetDefaultCongestionCtlConfig() const;
+
+    /// the congestion control config of the session with upnode, its override or the default one
+    CongestionCtlConfig GetCongestionCtlConfig(const basefw::ID& upnode) const;
+
+    /** @brief read the optional "congestionControl" objects of the downloader json, like
+     *  {"type": "cubic", "minWnd": 1, "maxWnd": 1024, "slowStartThreshold": 32, "bbr": {...}, "cubic": {...},
+     *  "coupled": {"initCwnd": 10, "algo": "lia"}}
+     *  The top level one overrides the fields above, the one inside an upnode applies to that upnode only.
+     *  The top level one may also hold {"pacer": {"burst": 8, "pacingGain": 1.25}} and
+     *  {"windowCap": {"initWnd": 64, "minWnd": 8, "bdpGain": 2.0, "memoryBudgetKB": 4096}}.
+     *  @return false if an object is malformed
+     * */
+    bool ParseCongestionCtlJson(const json& downnode);
+
+    /** @brief read the optional "multipathScheduler" object of the downloader json, like
+     *  {"type": "edf", "dupBudget": 0.02}
+     *  @return false if the object is malformed
+     * */
+    bool ParseMultiPathSchedulerJson(const json& downnode);
 
     std::string DebugInfo();
 };
@@ -105,8 +154,16 @@ public:
 
     void OnPiecePktTimeout(const basefw::ID& peerid, const std::vector<int32_t>& spns) override;
 
+    void OnPiecePktSpuriousLoss(const basefw::ID& peerid, int32_t spn) override;
+
+    void OnRttSample(const basefw::ID& peerid, Duration rtt, Timepoint recvtic) override;
+
     bool DoSendDataRequest(const basefw::ID& peerid, const std::vector<int32_t>& spns) override;
 
+    uint64_t ArmLossTimer(const basefw::ID& peerid, SeqNumber seq, Timepoint deadline) override;
+
+    void CancelLossTimer(uint64_t timerid) override;
+
     //Multipath scheduler handlers
 
     bool OnGetCurrPlayPos(uint64_t& currplaypos) override;
@@ -117,17 +174,60 @@ public:
 
     void OnRequestDownloadPieces(uint32_t maxpiececnt) override;
 
+    void ArmScheduleTimer(Timepoint deadline) override;
+
 private:
+    /// payload of a loss timer, the packet seq on a session
+    struct LossTimerKey
+    {
+        basefw::ID sessionid;
+        SeqNumber seq{ MAX_SEQNUMBER };
+    };
+
+    /** fire the due loss timers and let their sessions check loss
+     *  The wheel only turns when this is polled, on each packet received and on the alarm. While packets flow a
+     *  loss is found up to a wheel tick late. A tail loss, or a path gone dark while no other session receives, is
+     *  found on the next alarm, up to alarmIntervalMs late.
+     * */
+    void PollLossTimers(Timepoint now);
+
+    /// let the scheduler run the pass it armed the timer for, if it is due
+    void PollScheduleTimer(Timepoint now);
+
+    /// close the due bottleneck detection intervals and apply the new session groups if they changed
+    void CheckBottleneckGroups(Timepoint now);
+
+    /// couple the cc of the sessions in each detected group, tell the scheduler
+    void ApplyBottleneckGroups();
+
+    /// split the memory budget over the sessions by their window caps
+    void ShareWindowBudget();
 
     bool isRunning{ false };
     TransportDownloadTaskInfo m_tansDlTkInfo;/// task info, rid,filelength, etc
+    Timepoint m_firstRequestTic{ Timepoint::Zero() };/// when the first data request was sent
     std::shared_ptr<DemoTransportCtlConfig> m_transCtlConfig;/// transport module config
     std::unique_ptr<MultiPathSchedulerAlgo> m_multipathscheduler;/// multipath scheduler
     std::weak_ptr<MPDTransCtlHandler> m_transctlHandler; // transport module call back
-    std::set<DataNumber> m_downloadPieces;/// main task download queue
-    std::set<DataNumber> m_lostPiecesl;/// lost packets will be stored here till retransmission
-    RenoCongestionCtlConfig renoccConfig;/// congestion config file
-    std::map<basefw::ID, std::shared_ptr<SessionStreamController>> m_sessStreamCtlMap;/// map session id to sessionstream
+    PieceSet m_downloadPieces;/// main task download queue
+    PieceSet m_lostPiecesl;/// lost packets will be stored here till retransmission
+    std::unordered_map<basefw::ID, std::shared_ptr<SessionStreamController>> m_sessStreamCtlMap;/// map session id to sessionstream
+    std::unique_ptr<TimerWheel<LossTimerKey>> m_lossTimerWheel;/// per packet loss deadlines of all sessions
+    Timepoint m_scheduleTimerTic{ Timepoint::Zero() };/// deadline armed by the scheduler, zero if none
+    std::shared_ptr<CoupledCongestionCtlGroup> m_coupledCcGroup;/// coupled cc group of the sessions not grouped yet
+    SharedBottleneckDetector m_bottleneckDetector;/// groups the sessions by the bottleneck they share
+};
+
+/** @class The transport module settings of the demo, the alarm period comes from the DemoTransportCtlConfig.
+ *  The alarm is the only clock the transport controller gets between packets, the loss timers and the pacer are
+ *  checked on it, so it runs more often than the default 100ms.
+ * */
+class DemoTransportModuleSettings : public TransportModuleSettings
+{
+public:
+    ~DemoTransportModuleSettings() override = default;
+
+    uint32_t GetAlarmInterval() override;
 };
 
 /** @class A demo TransportController used to create DemoTransportCtl
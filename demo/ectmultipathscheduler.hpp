@@ -0,0 +1,237 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include "basefw/base/log.h"
+#include "rrmultipathscheduler.hpp"
+
+/** Earliest completion time multipath scheduler, after ECF (Lim et al., CoNEXT 2017).
+ *  Each piece of the download queue, lowest first, goes to the session predicted to deliver it first:
+ *  srtt + (queued + assigned + 1) / delivery rate. A piece whose best session has no free window is left in the
+ *  download queue for it, counted as assigned, instead of going to a slower session that would deliver it later.
+ *  The slower session gets a piece further ahead then, so enough pieces are asked for to cover what the faster
+ *  sessions would deliver before it.
+ *  The session queues, loss and reset handling are those of the RR scheduler.
+ * */
+class ECTMultiPathScheduler : public RRMultiPathScheduler
+{
+public:
+    MultiPathSchedulerType SchedulerType() override
+    {
+        return MultiPathSchedulerType::MULTI_PATH_SCHEDULE_ECT;
+    }
+
+    explicit ECTMultiPathScheduler(const fw::ID& taskid,
+            std::unordered_map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
+            PieceSet& downloadQueue, PieceSet& lostPiecesQueue)
+            : RRMultiPathScheduler(taskid, dlsessionmap, downloadQueue, lostPiecesQueue)
+    {
+        SPDLOG_DEBUG("taskid :{}", taskid.ToLogStr());
+    }
+
+    ~ECTMultiPathScheduler() override
+    {
+        SPDLOG_TRACE("");
+    }
+
+    void DoMultiPathSchedule() override
+    {
+        if (m_session_needdownloadpieceQ.empty())
+        {
+            SPDLOG_DEBUG("Empty session map");
+            return;
+        }
+        SPDLOG_TRACE("DoMultiPathSchedule");
+        FillUpByCompletionTime();
+    }
+
+    uint32_t DoSinglePathSchedule(const fw::ID& sessionid) override
+    {
+        SPDLOG_DEBUG("session:{}", sessionid.ToLogStr());
+        auto&& itor = m_dlsessionmap.find(sessionid);
+        if (itor == m_dlsessionmap.end() || !itor->second)
+        {
+            SPDLOG_WARN("Unknown session: {}", sessionid.ToLogStr());
+            return -1;
+        }
+        if (itor->second->CanRequestPktCnt() == 0)
+        {
+            SPDLOG_TRACE("Free Wnd equals to 0");
+            return -1;
+        }
+        // the window opened on this session may still be better used by a faster one
+        FillUpByCompletionTime();
+        return 0;
+    }
+
+protected:
+    /// the sending state of one session during an assignment round
+    struct PathState
+    {
+        fw::ID sessionid;
+        fw::shared_ptr<SessionStreamController> session;
+        uint32_t freeCnt{ 0 };/** pieces it can request now besides its queue*/
+        size_t queuedCnt{ 0 };/** pieces in its queue, not requested yet*/
+        double srttSec{ 0 };
+        double rate{ 0 };/** pieces per second*/
+        uint32_t assignedCnt{ 0 };/** pieces given this round, including those left waiting for it*/
+        std::vector<DataNumber> toSend;
+    };
+
+    /// seconds from now until the next piece given to path would be delivered
+    static double CompletionTime(const PathState& path)
+    {
+        return path.srttSec + (path.queuedCnt + path.assignedCnt + 1) / path.rate;
+    }
+
+    /// pieces the other sessions would deliver before the first piece given to a session with free window
+    static size_t LookaheadCnt(const std::vector<PathState>& paths)
+    {
+        double lookahead = 0;
+        for (auto&& path: paths)
+        {
+            if (path.freeCnt == 0)
+            {
+                continue;
+            }
+            double ect = CompletionTime(path);
+            double ahead = 0;
+            for (auto&& other: paths)
+            {
+                if (&other != &path)
+                {
+                    ahead += std::max(0.0, (ect - other.srttSec) * other.rate - other.queuedCnt);
+                }
+            }
+            lookahead = std::max(lookahead, ahead);
+        }
+        return lookahead < kECTMaxLookahead ? static_cast<size_t>(lookahead) : kECTMaxLookahead;
+    }
+
+    /// path may be given piece pno, it isn't requested there already
+    virtual bool MayTake(const PathState& path, DataNumber pno) const
+    {
+        return true;
+    }
+
+    /// the session to give piece pno to, the one predicted to deliver it first, nullptr if none may take it
+    virtual PathState* PickPath(DataNumber pno, std::vector<PathState>& paths)
+    {
+        PathState* best = nullptr;
+        for (auto&& path: paths)
+        {
+            if (!MayTake(path, pno))
+            {
+                continue;
+            }
+            if (!best || CompletionTime(path) < CompletionTime(*best) ||
+                (CompletionTime(path) == CompletionTime(*best) && path.toSend.size() < path.freeCnt))
+            {
+                best = &path;
+            }
+        }
+        return best;
+    }
+
+    /// the state of every session with a task queue, nothing assigned yet
+    std::vector<PathState> CollectPaths()
+    {
+        std::vector<PathState> paths;
+        for (auto&& id_sess: m_dlsessionmap)
+        {
+            auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(id_sess.first);
+            if (!id_sess.second || itor_id_ssQ == m_session_needdownloadpieceQ.end())
+            {
+                continue;
+            }
+            PathState path;
+            path.sessionid = id_sess.first;
+            path.session = id_sess.second;
+            path.queuedCnt = itor_id_ssQ->second.size();
+            path.freeCnt = BatchedFreeWnd(id_sess.first, id_sess.second, path.queuedCnt);
+            path.srttSec = id_sess.second->GetSmoothedOrInitialRtt().ToMicroseconds() / 1000000.0;
+            path.rate = ExpectedRate(id_sess.second);
+            paths.push_back(path);
+        }
+        return paths;
+    }
+
+    virtual void FillUpByCompletionTime()
+    {
+        RequeueLostPieces();
+        StealQueuedPieces();
+
+        std::vector<PathState> paths = CollectPaths();
+        uint32_t totalFreeCnt = 0;
+        for (auto&& path: paths)
+        {
+            totalFreeCnt += path.freeCnt;
+        }
+        if (totalFreeCnt == 0)
+        {
+            // only the pieces queued already may be requested
+            for (auto&& path: paths)
+            {
+                if (path.queuedCnt > 0)
+                {
+                    DoSendSessionSubTask(path.sessionid);
+                }
+            }
+            return;
+        }
+
+        size_t wantedCnt = totalFreeCnt + LookaheadCnt(paths);
+        if (m_downloadQueue.size() < wantedCnt)
+        {
+            auto handler = m_phandler.lock();
+            if (handler)
+            {
+                handler->OnRequestDownloadPieces(wantedCnt - m_downloadQueue.size());
+            }
+            else
+            {
+                SPDLOG_ERROR("handler = null");
+            }
+        }
+
+        uint32_t freeLeft = totalFreeCnt;
+        for (auto itr = m_downloadQueue.begin(); itr != m_downloadQueue.end() && freeLeft > 0;)
+        {
+            DataNumber pno = *itr;
+            ++itr;
+            PathState* best = PickPath(pno, paths);
+            if (!best)
+            {
+                // requested on every session already, the requests in flight will deliver it
+                m_downloadQueue.Erase(pno);
+                continue;
+            }
+            ++best->assignedCnt;
+            if (best->toSend.size() < best->freeCnt)
+            {
+                best->toSend.push_back(pno);
+                m_downloadQueue.Erase(pno);
+                --freeLeft;
+            }
+            // otherwise waiting for the best session is better than any free one
+        }
+
+        for (auto&& path: paths)
+        {
+            if (path.freeCnt > path.toSend.size())
+            {
+                SPDLOG_TRACE("session {} left {} free wnd, ect {}", path.sessionid.ToLogStr(),
+                        path.freeCnt - path.toSend.size(), CompletionTime(path));
+                path.session->OnAppLimited();
+            }
+            if (!path.toSend.empty() || path.queuedCnt > 0)
+            {
+                m_session_needdownloadpieceQ[path.sessionid].Insert(path.toSend.begin(), path.toSend.end());
+                DoSendSessionSubTask(path.sessionid);
+            }
+        }
+    }
+
+    static constexpr size_t kECTMaxLookahead = 512;/** pieces asked for ahead of the free windows at most*/
+};
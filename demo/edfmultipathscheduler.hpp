@@ -0,0 +1,342 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "basefw/base/log.h"
+#include "ectmultipathscheduler.hpp"
+
+/** Playback deadline aware multipath scheduler, earliest deadline first.
+ *  Piece n is played (n * 1KB) / byterate after the start of the file, so its deadline is that far from the current
+ *  play position. The download queue is sorted by piece, which is deadline order. Each piece goes to the session
+ *  with free window that would deliver it last while still one srtt before its deadline, so the faster sessions stay
+ *  free for the pieces only they can deliver in time. A piece no free session can deliver in time waits for the
+ *  session predicted to deliver it first, as in the ECT scheduler, which is also used when the handler doesn't
+ *  know the play position or byterate.
+ *
+ *  A piece in flight that is predicted to arrive after its deadline, because its session has slowed down since it
+ *  was requested or has likely lost it, is requested once more on the other session that would deliver it first,
+ *  if that one makes the deadline. A piece late as predicted when it was requested isn't, the sessions are short
+ *  of capacity then and a copy would only delay other pieces. The duplicates are kept within dupBudget of the
+ *  bytes requested. The copy that arrives first completes the piece, the other one is ignored on arrival, or
+ *  dropped from the queues if not requested yet, and its loss doesn't bring the piece back to the download queue.
+ * */
+class EDFMultiPathScheduler : public ECTMultiPathScheduler
+{
+public:
+    MultiPathSchedulerType SchedulerType() override
+    {
+        return MultiPathSchedulerType::MULTI_PATH_SCHEDULE_EDF;
+    }
+
+    /// @param dupBudget duplicate requests over all requests, in bytes, 0 never duplicates
+    explicit EDFMultiPathScheduler(const fw::ID& taskid,
+            std::unordered_map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
+            PieceSet& downloadQueue, PieceSet& lostPiecesQueue, double dupBudget = 0)
+            : ECTMultiPathScheduler(taskid, dlsessionmap, downloadQueue, lostPiecesQueue), m_dupBudget(dupBudget)
+    {
+        SPDLOG_DEBUG("taskid :{} dupBudget: {}", taskid.ToLogStr(), dupBudget);
+    }
+
+    ~EDFMultiPathScheduler() override
+    {
+        SPDLOG_DEBUG("requested: {} duplicated: {}", m_requestedCnt, m_dupCnt);
+    }
+
+    void OnSessionDestory(const fw::ID& sessionid) override
+    {
+        // its requests will never complete, the pieces without another copy are lost
+        for (auto itor = m_inflightPieces.begin(); itor != m_inflightPieces.end();)
+        {
+            if (RemoveCopy(itor->second, sessionid) && itor->second.empty())
+            {
+                m_lostPiecesQueue.Insert(itor->first);
+                m_inflightPieces.erase(itor++);
+            }
+            else
+            {
+                ++itor;
+            }
+        }
+        ECTMultiPathScheduler::OnSessionDestory(sessionid);
+    }
+
+    void OnResetDownload() override
+    {
+        m_inflightPieces.clear();
+        ECTMultiPathScheduler::OnResetDownload();
+    }
+
+    void OnTimedOut(const fw::ID& sessionid, const std::vector<int32_t>& pns) override
+    {
+        std::vector<int32_t> lost;
+        for (auto&& pno: pns)
+        {
+            auto&& itor = m_inflightPieces.find(pno);
+            if (itor == m_inflightPieces.end())
+            {
+                SPDLOG_TRACE("piece {} lost on session {} has arrived on another one", pno, sessionid.ToLogStr());
+                continue;
+            }
+            RemoveCopy(itor->second, sessionid);
+            if (!itor->second.empty())
+            {
+                SPDLOG_TRACE("piece {} lost on session {} is still requested on another one", pno,
+                        sessionid.ToLogStr());
+                continue;
+            }
+            m_inflightPieces.erase(itor);
+            lost.push_back(pno);
+        }
+        if (!lost.empty())
+        {
+            ECTMultiPathScheduler::OnTimedOut(sessionid, lost);
+        }
+    }
+
+    void OnReceiveSubpieceData(const fw::ID& sessionid, SeqNumber seq, DataNumber pno, Timepoint recvtime) override
+    {
+        // the first copy wins, a later one finds nothing to complete
+        if (m_inflightPieces.erase(pno) > 0)
+        {
+            // nor does a duplicate not requested yet
+            m_downloadQueue.Erase(pno);
+            for (auto&& it_sn: m_session_needdownloadpieceQ)
+            {
+                it_sn.second.Erase(pno);
+            }
+        }
+        ECTMultiPathScheduler::OnReceiveSubpieceData(sessionid, seq, pno, recvtime);
+    }
+
+protected:
+    /// one request of a piece in flight
+    struct PieceCopy
+    {
+        fw::ID sessionid;
+        Timepoint sendtic{ Timepoint::Zero() };
+        uint32_t aheadCnt{ 0 };/** requests in flight on the session before it*/
+        double expectedSec{ 0 };/** ExpectedArrival when it was requested*/
+    };
+
+    void OnPiecesRequested(const fw::ID& sessionid, const std::vector<DataNumber>& pieces) override
+    {
+        PieceCopy copy;
+        copy.sessionid = sessionid;
+        copy.sendtic = Clock::GetClock()->Now();
+        auto&& itor = m_dlsessionmap.find(sessionid);
+        if (itor == m_dlsessionmap.end() || !itor->second)
+        {
+            return;
+        }
+        copy.aheadCnt = itor->second->GetInFlightPktNum();
+        for (auto&& pno: pieces)
+        {
+            auto& copies = m_inflightPieces[pno];
+            if (!copies.empty())
+            {
+                ++m_dupCnt;
+            }
+            copy.expectedSec = ExpectedArrival(itor->second, copy.aheadCnt);
+            copies.push_back(copy);
+            ++copy.aheadCnt;
+            ++m_requestedCnt;
+        }
+    }
+
+    void FillUpByCompletionTime() override
+    {
+        m_hasDeadline = false;
+        auto handler = m_phandler.lock();
+        if (handler && handler->OnGetCurrPlayPos(m_playPos) && handler->OnGetByteRate(m_byterate) && m_byterate > 0)
+        {
+            m_hasDeadline = true;
+        }
+        if (m_hasDeadline && m_dupBudget > 0)
+        {
+            // the pieces closest to their deadline come before new ones
+            DuplicateAtRiskPieces();
+        }
+        ECTMultiPathScheduler::FillUpByCompletionTime();
+    }
+
+    /// a duplicate back in the download queue goes to a session without a copy in flight
+    bool MayTake(const PathState& path, DataNumber pno) const override
+    {
+        auto&& itor = m_inflightPieces.find(pno);
+        if (itor == m_inflightPieces.end())
+        {
+            return true;
+        }
+        for (auto&& copy: itor->second)
+        {
+            if (copy.sessionid == path.sessionid)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PathState* PickPath(DataNumber pno, std::vector<PathState>& paths) override
+    {
+        PathState* earliest = ECTMultiPathScheduler::PickPath(pno, paths);
+        if (!m_hasDeadline || !earliest)
+        {
+            return earliest;
+        }
+        double slack = SecondsToDeadline(pno);
+        PathState* latestInTime = nullptr;
+        for (auto&& path: paths)
+        {
+            if (path.toSend.size() >= path.freeCnt || !MayTake(path, pno) || CompletionTime(path) + path.srttSec > slack)
+            {
+                continue;
+            }
+            if (!latestInTime || CompletionTime(path) > CompletionTime(*latestInTime))
+            {
+                latestInTime = &path;
+            }
+        }
+        if (!latestInTime)
+        {
+            SPDLOG_TRACE("piece {} due in {}s, waits for the earliest session", pno, slack);
+            return earliest;
+        }
+        return latestInTime;
+    }
+
+    /// request the pieces in flight that would miss their deadline once more, on a session that would beat them.
+    /// The pieces are visited in deadline order, the budget goes to the most urgent ones
+    void DuplicateAtRiskPieces()
+    {
+        std::vector<PathState> paths = CollectPaths();
+        std::unordered_map<fw::ID, PathState*> pathById;
+        for (auto&& path: paths)
+        {
+            pathById.emplace(path.sessionid, &path);
+        }
+        Timepoint now = Clock::GetClock()->Now();
+        uint64_t newDupCnt = 0;
+        for (auto&& pno_copies: m_inflightPieces)
+        {
+            if (m_dupCnt + newDupCnt + 1 > m_dupBudget * (m_requestedCnt + newDupCnt + 1))
+            {
+                SPDLOG_TRACE("duplicate budget used up, {} of {}", m_dupCnt, m_requestedCnt);
+                break;
+            }
+            double slack = SecondsToDeadline(pno_copies.first);
+            if (pno_copies.second.size() != 1)
+            {
+                continue;
+            }
+            const PieceCopy& copy = pno_copies.second.front();
+            auto&& itor_owner = pathById.find(copy.sessionid);
+            if (itor_owner == pathById.end())
+            {
+                continue;
+            }
+            PathState* owner = itor_owner->second;
+            double elapsed = (now - copy.sendtic).ToMicroseconds() / 1000000.0;
+            double expected = ExpectedArrival(owner->session, copy.aheadCnt);
+            double remaining = 0;
+            if (elapsed > copy.expectedSec + owner->srttSec)
+            {
+                // overdue, it has likely been lost and would be requested again
+                remaining = owner->srttSec;
+            }
+            else if (expected > copy.expectedSec + owner->srttSec)
+            {
+                // the session has slowed down since
+                remaining = expected - elapsed;
+            }
+            else
+            {
+                // late as expected when it was requested, the sessions are short of capacity and a copy won't help
+                continue;
+            }
+            if (remaining <= slack)
+            {
+                continue;
+            }
+            PathState* best = nullptr;
+            for (auto&& path: paths)
+            {
+                if (&path == owner || path.toSend.size() >= path.freeCnt)
+                {
+                    continue;
+                }
+                if (!best || CompletionTime(path) < CompletionTime(*best))
+                {
+                    best = &path;
+                }
+            }
+            if (!best || CompletionTime(*best) >= remaining || CompletionTime(*best) + best->srttSec > slack)
+            {
+                // a copy that would be late as well only takes the window of pieces still in time
+                continue;
+            }
+            SPDLOG_DEBUG("piece {} due in {}s, expected on {} in {}s, duplicated on {} in {}s", pno_copies.first,
+                    slack, owner->sessionid.ToLogStr(), remaining, best->sessionid.ToLogStr(), CompletionTime(*best));
+            best->toSend.push_back(pno_copies.first);
+            ++best->assignedCnt;
+            ++newDupCnt;
+        }
+
+        for (auto&& path: paths)
+        {
+            if (!path.toSend.empty())
+            {
+                m_session_needdownloadpieceQ[path.sessionid].Insert(path.toSend.begin(), path.toSend.end());
+                DoSendSessionSubTask(path.sessionid);
+            }
+        }
+    }
+
+    /** seconds after its request that copy is expected to arrive, when the requests ahead of it on the session
+     *  have been delivered at the latest delivery rate. It grows as soon as the session slows down, while the srtt
+     *  only catches up once the delayed pieces arrive.
+     * */
+    static double ExpectedArrival(const fw::shared_ptr<SessionStreamController>& session, uint32_t aheadCnt)
+    {
+        double rate = session->GetDeliveryRate();
+        if (rate < kMinExpectedRate)
+        {
+            rate = kMinExpectedRate;
+        }
+        return session->GetMinRtt().ToMicroseconds() / 1000000.0 + (aheadCnt + 1) / rate;
+    }
+
+    /// @return true if copies had a request on sessionid
+    static bool RemoveCopy(std::vector<PieceCopy>& copies, const fw::ID& sessionid)
+    {
+        for (auto itor = copies.begin(); itor != copies.end(); ++itor)
+        {
+            if (itor->sessionid == sessionid)
+            {
+                copies.erase(itor);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// seconds until the player reaches piece pno, negative if it has passed
+    double SecondsToDeadline(DataNumber pno) const
+    {
+        return (static_cast<double>(pno) * kPieceBytes - static_cast<double>(m_playPos)) / m_byterate;
+    }
+
+    static constexpr uint32_t kPieceBytes = 1024;
+
+    bool m_hasDeadline{ false };/** the play position and byterate are known in this round*/
+    uint64_t m_playPos{ 0 };/** bytes*/
+    uint32_t m_byterate{ 0 };/** bytes per second*/
+
+    double m_dupBudget{ 0 };
+    std::map<DataNumber, std::vector<PieceCopy>> m_inflightPieces;/** requests in flight of each piece*/
+    uint64_t m_requestedCnt{ 0 };/** pieces requested, duplicates included, all of 1KB*/
+    uint64_t m_dupCnt{ 0 };/** second requests of a piece in flight*/
+};
@@ -0,0 +1,35 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "basefw/base/hash.h"
+
+namespace std
+{
+    /** basefw::ID is a 20 byte digest hashed as two 8 byte words and its 4 byte tail, each step a bijection of the
+     *  word it mixes in, so IDs differing in any byte, such as peer IDs numbered in their last one, spread over the
+     *  buckets of the session maps looked up on every packet.
+     * */
+    template <>
+    struct hash<basefw::ID>
+    {
+        size_t operator()(const basefw::ID& id) const
+        {
+            static_assert(sizeof(basefw::ID) >= 20, "basefw::ID is a 20 byte digest");
+            const uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+            uint64_t head = 0;
+            uint64_t mid = 0;
+            uint32_t tail = 0;
+            std::memcpy(&head, id.Getbuf(), sizeof(head));
+            std::memcpy(&mid, id.Getbuf() + 8, sizeof(mid));
+            std::memcpy(&tail, id.Getbuf() + 16, sizeof(tail));
+            uint64_t h = (head ^ mid) * kMul;
+            h = (h ^ tail) * kMul;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+    };
+}
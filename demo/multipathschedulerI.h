@@ -3,16 +3,39 @@
 #pragma once
 
 #include <map>
+#include <string>
+#include <unordered_map>
 #include "basefw/base/hash.h"
+#include "idhash.hpp"
 #include "basefw/base/shared_ptr.h"
 #include "sessionstreamcontroller.hpp"
+#include "pieceset.hpp"
 
 enum MultiPathSchedulerType
 {
     MULTI_PATH_SCHEDULE_NONE = 0,
     MULTI_PATH_SCHEDULE_RR = 1,
+    MULTI_PATH_SCHEDULE_ECT = 2,/** earliest completion time*/
+    MULTI_PATH_SCHEDULE_EDF = 3,/** earliest playback deadline first*/
 };
 
+/// the name used in the downloader json, "rr", "ect" or "edf"
+inline bool MultiPathSchedulerTypeFromName(const std::string& name, MultiPathSchedulerType& type)
+{
+    static const std::map<std::string, MultiPathSchedulerType> kTypes{
+            { "rr",  MULTI_PATH_SCHEDULE_RR },
+            { "ect", MULTI_PATH_SCHEDULE_ECT },
+            { "edf", MULTI_PATH_SCHEDULE_EDF },
+    };
+    auto&& itor = kTypes.find(name);
+    if (itor == kTypes.end())
+    {
+        return false;
+    }
+    type = itor->second;
+    return true;
+}
+
 class MultiPathSchedulerHandler
 {
 public:
@@ -24,6 +47,10 @@ public:
 
     virtual void OnRequestDownloadPieces(uint32_t maxsubpiececnt) = 0; // ask for more subpieces
 
+    /// call OnScheduleTimer once deadline has passed, as soon as the handler runs after it. Only the earliest
+    /// deadline armed is kept, until it fires
+    virtual void ArmScheduleTimer(Timepoint deadline) = 0;
+
     virtual ~MultiPathSchedulerHandler() = default;
 };
 
@@ -31,8 +58,8 @@ class MultiPathSchedulerAlgo
 {
 public:
     explicit MultiPathSchedulerAlgo(const fw::ID& taskid,
-            std::map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
-            std::set<DataNumber>& downloadQueue, std::set<int32_t>& lostPiecesQueue)
+            std::unordered_map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
+            PieceSet& downloadQueue, PieceSet& lostPiecesQueue)
             : m_taskid(taskid), m_dlsessionmap(dlsessionmap),
               m_downloadQueue(downloadQueue), m_lostPiecesQueue(lostPiecesQueue)
     {
@@ -59,9 +86,27 @@ public:
 
     virtual void OnTimedOut(const fw::ID& sessionid, const std::vector<int32_t>& spns) = 0;
 
+    /// a piece reported by OnTimedOut has been received on sessionid, drop its pending retransmission
+    virtual void OnSpuriousLoss(const fw::ID& sessionid, DataNumber pno) = 0;
+
     virtual void OnReceiveSubpieceData(const fw::ID& sessionid, SeqNumber seq, DataNumber pno, Timepoint recvtime) = 0;
 
-    virtual void SortSession(std::multimap<Duration, fw::shared_ptr<SessionStreamController>>& sortmmap) = 0;
+    /// the free window of sessionid has grown by cnt pieces
+    virtual void OnWindowOpened(const fw::ID& sessionid, uint32_t cnt) = 0;
+
+    /// cnt pieces have been added to the download queue
+    virtual void OnTasksAdded(uint32_t cnt) = 0;
+
+    /// the periodic alarm, reschedule if anything has changed since the last scheduling pass
+    virtual void OnScheduleAlarm() = 0;
+
+    /// the deadline armed by ArmScheduleTimer has passed, what was held back until then may be requested
+    virtual void OnScheduleTimer() = 0;
+
+    /// the sessions have been regrouped by the bottleneck they share, sessions of different groups are independent
+    virtual void OnBottleneckGroupsChanged(const std::vector<std::vector<fw::ID>>& groups)
+    {
+    }
 
     virtual int32_t DoSendSessionSubTask(const fw::ID& sessionid) = 0;
 
@@ -69,8 +114,8 @@ public:
 
 protected:
     fw::ID m_taskid;
-    std::map<fw::ID, fw::shared_ptr<SessionStreamController>>& m_dlsessionmap;
-    std::set<DataNumber>& m_downloadQueue; // main task queue
-    std::set<DataNumber>& m_lostPiecesQueue;// the lost pieces queue, waiting to be retransmitted
+    std::unordered_map<fw::ID, fw::shared_ptr<SessionStreamController>>& m_dlsessionmap;
+    PieceSet& m_downloadQueue; // main task queue
+    PieceSet& m_lostPiecesQueue;// the lost pieces queue, waiting to be retransmitted
 };
 
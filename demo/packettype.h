@@ -1,19 +1,24 @@
 // Copyright (c) 2023. ByteDance Inc. All rights reserved.
 
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <vector>
+#include "utils/eventtrace.hpp"
+
 using SeqNumber = uint32_t;
 using DataNumber = int32_t;
 #define MAX_SEQNUMBER std::numeric_limits<uint32_t>::max()
 #define MAX_DATANUMBER std::numeric_limits<int32_t>::max()
 
-#include <sstream>
-
+/// Packet records are plain values: they are copied into rings, loss events and ack events on every packet,
+/// so keep them free of virtual functions.
 struct DataPacket
 {
     SeqNumber seq{ MAX_SEQNUMBER };
     DataNumber pieceId{ MAX_DATANUMBER };
-
-    virtual ~DataPacket() = default;
 };
 
 struct InflightPacket : DataPacket
@@ -28,16 +33,12 @@ struct InflightPacket : DataPacket
         return os;
     }
 
-    virtual std::string DebugInfo()
+    std::string DebugInfo() const
     {
         std::stringstream ss;
         ss << *this;
         return ss.str();
     }
-
-    ~InflightPacket() override
-    {
-    }
 };
 
 struct AckedPacket : InflightPacket
@@ -51,18 +52,255 @@ struct AckedPacket : InflightPacket
         return os;
     }
 
-    virtual std::string DebugInfo() override
+    std::string DebugInfo() const
     {
         std::stringstream ss;
         ss << *this;
         return ss.str();
     }
+};
+
+/// A contiguous ring buffer indexed by (seq - base seq).
+/// Sequence numbers are handed out monotonically per session, so insert/find/erase are O(1) and
+/// only a capacity growth allocates. Erased slots are tombstoned in a bitmap, and the base slides
+/// forward over leading tombstones so the ring only spans [oldest live seq, newest seq].
+template <typename T>
+class SeqIndexedRing
+{
+public:
+    /// element seen while iterating, mimics the std::pair of a map
+    struct Entry
+    {
+        SeqNumber first;
+        const T& second;
+    };
+
+    class const_iterator
+    {
+    public:
+        const_iterator(const SeqIndexedRing* ring, uint32_t offset) : m_ring(ring), m_offset(offset)
+        {
+            SkipTombstones();
+        }
+
+        Entry operator*() const
+        {
+            return Entry{ m_ring->m_baseSeq + m_offset, m_ring->m_slots[m_ring->SlotOf(m_offset)] };
+        }
+
+        const_iterator& operator++()
+        {
+            ++m_offset;
+            SkipTombstones();
+            return *this;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return m_offset != other.m_offset;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return m_offset == other.m_offset;
+        }
+
+    private:
+        void SkipTombstones()
+        {
+            while (m_offset < m_ring->m_span && !m_ring->IsLive(m_ring->SlotOf(m_offset)))
+            {
+                ++m_offset;
+            }
+        }
+
+        const SeqIndexedRing* m_ring;
+        uint32_t m_offset;
+    };
+
+    /// @return false if seq is already in the ring
+    bool Insert(SeqNumber seq, const T& val)
+    {
+        if (m_size == 0)
+        {
+            // nothing alive, rebase on the new seq so gaps between bursts cost nothing
+            if (m_slots.empty())
+            {
+                Relayout(kInitCapacity);
+            }
+            m_baseSeq = seq;
+            m_head = 0;
+            m_span = 0;
+        }
+        else if (seq < m_baseSeq)
+        {
+            // a seq older than the oldest live one, extend the ring backwards
+            uint32_t extra = m_baseSeq - seq;
+            if (uint64_t(m_span) + extra > kMaxSpan)
+            {
+                SPDLOG_WARN("seq {} is too far behind base seq {}", seq, m_baseSeq);
+                return false;
+            }
+            if (uint64_t(m_span) + extra > m_slots.size())
+            {
+                Relayout(uint64_t(m_span) + extra);
+            }
+            m_head = (m_head - extra) & Mask();
+            m_baseSeq = seq;
+            m_span += extra;
+        }
+
+        uint32_t offset = seq - m_baseSeq;
+        if (offset >= kMaxSpan)
+        {
+            SPDLOG_WARN("seq {} is too far ahead of base seq {}", seq, m_baseSeq);
+            return false;
+        }
+        if (offset >= m_slots.size())
+        {
+            Relayout(uint64_t(offset) + 1);
+        }
+        auto slot = SlotOf(offset);
+        if (offset < m_span && IsLive(slot))
+        {
+            return false;
+        }
+        m_slots[slot] = val;
+        m_live[slot >> 6] |= (uint64_t(1) << (slot & 63));
+        m_span = std::max(m_span, offset + 1);
+        ++m_size;
+        return true;
+    }
+
+    const T* Find(SeqNumber seq) const
+    {
+        if (m_size == 0 || seq < m_baseSeq || seq - m_baseSeq >= m_span)
+        {
+            return nullptr;
+        }
+        auto slot = SlotOf(seq - m_baseSeq);
+        return IsLive(slot) ? &m_slots[slot] : nullptr;
+    }
+
+    T* Find(SeqNumber seq)
+    {
+        return const_cast<T*>(static_cast<const SeqIndexedRing*>(this)->Find(seq));
+    }
+
+    /// tombstone the slot of seq, @return false if seq is not in the ring
+    bool Erase(SeqNumber seq)
+    {
+        if (!Find(seq))
+        {
+            return false;
+        }
+        auto slot = SlotOf(seq - m_baseSeq);
+        m_live[slot >> 6] &= ~(uint64_t(1) << (slot & 63));
+        --m_size;
+        if (m_size == 0)
+        {
+            m_span = 0;
+            return true;
+        }
+        // slide the base over leading tombstones, each slot is passed at most once
+        while (!IsLive(m_head))
+        {
+            m_head = (m_head + 1) & Mask();
+            ++m_baseSeq;
+            --m_span;
+        }
+        return true;
+    }
 
-    ~AckedPacket() override
+    void Clear()
     {
+        std::fill(m_live.begin(), m_live.end(), 0);
+        m_size = 0;
+        m_span = 0;
     }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    /// the oldest live seq, only meaningful if not empty
+    SeqNumber BaseSeq() const
+    {
+        return m_baseSeq;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, m_span);
+    }
+
+private:
+    static constexpr uint32_t kInitCapacity = 64;
+    static constexpr uint32_t kMaxSpan = 1U << 22;/** guard against a wild seq blowing up the ring*/
+
+    uint32_t Mask() const
+    {
+        return static_cast<uint32_t>(m_slots.size()) - 1;
+    }
+
+    uint32_t SlotOf(uint32_t offset) const
+    {
+        return (m_head + offset) & Mask();
+    }
+
+    bool IsLive(uint32_t slot) const
+    {
+        return (m_live[slot >> 6] >> (slot & 63)) & 1;
+    }
+
+    /// grow to a power of two no less than minCapacity and move the live span to the front
+    void Relayout(uint64_t minCapacity)
+    {
+        uint64_t capacity = std::max<uint64_t>(kInitCapacity, m_slots.size());
+        while (capacity < minCapacity)
+        {
+            capacity <<= 1;
+        }
+        std::vector<T> slots(capacity);
+        std::vector<uint64_t> live(capacity / 64, 0);
+        for (uint32_t offset = 0; offset < m_span; ++offset)
+        {
+            auto slot = SlotOf(offset);
+            if (IsLive(slot))
+            {
+                slots[offset] = m_slots[slot];
+                live[offset >> 6] |= (uint64_t(1) << (offset & 63));
+            }
+        }
+        m_slots.swap(slots);
+        m_live.swap(live);
+        m_head = 0;
+    }
+
+    std::vector<T> m_slots;
+    std::vector<uint64_t> m_live;/** one bit per slot, cleared bits are tombstones of acked or lost packets*/
+    SeqNumber m_baseSeq{ 0 };
+    uint32_t m_head{ 0 };/** slot of m_baseSeq*/
+    uint32_t m_span{ 0 };/** slots in use, from m_baseSeq to the newest seq*/
+    size_t m_size{ 0 };/** live slots*/
 };
 
+template <typename T>
+constexpr uint32_t SeqIndexedRing<T>::kInitCapacity;
+template <typename T>
+constexpr uint32_t SeqIndexedRing<T>::kMaxSpan;
+
 class InFlightPacketMap
 {
 public:
@@ -73,32 +311,30 @@ public:
         inflightPacket.pieceId = p.pieceId;
         inflightPacket.sendtic = sendtic;
         inflightPacket.inflight = inflightPktMap.size();
-        auto&& itor_pair = inflightPktMap.emplace(std::make_pair(p.seq, p.pieceId), inflightPacket);
-        if (!itor_pair.second)
+        if (!inflightPktMap.Insert(p.seq, inflightPacket))
         {
             SPDLOG_WARN("insert failed with seq = {},duplicate pkt?", p.seq);
         }
         else
         {
+            AddToSendOrder(inflightPacket);
             if (p.seq > maxSeqInflightPkt.seq || maxSeqInflightPkt.seq == MAX_SEQNUMBER)
             {
                 maxSeqInflightPkt = inflightPacket;
             }
-            SPDLOG_DEBUG("Add pkt with seq = {}, max inflight {}, max acked {}", p.seq,
-                    MaxSeqInflightPkt().DebugInfo(), MaxSeqAckedPkt().DebugInfo());
+            DEMO_TRACE_INFLIGHT(TraceEvent::pktSent, p.seq, p.pieceId, sendtic.ToDebuggingValue(),
+                    sendtic.ToDebuggingValue(), 0, inflightPktMap.size());
         }
-
-        SPDLOG_TRACE("Sent seq:{}, map now:{}", p.seq, DebugInfo());
     }
 
     void OnPacktReceived(InflightPacket& p, QuicTime recvtic)
     {
-        auto&& itor = inflightPktMap.find(std::make_pair(p.seq, p.pieceId));
-        if (itor != inflightPktMap.end())
+        if (FindPkt(p.seq, p.pieceId))
         {
-            inflightPktMap.erase(std::make_pair(p.seq, p.pieceId));
-            SPDLOG_DEBUG("recv pkt with seq = {}, max inflight {}, max acked {}", p.seq,
-                    MaxSeqInflightPkt().DebugInfo(), MaxSeqAckedPkt().DebugInfo());
+            inflightPktMap.Erase(p.seq);
+            PopDeadSendOrder();
+            DEMO_TRACE_INFLIGHT(TraceEvent::pktAcked, p.seq, p.pieceId, recvtic.ToDebuggingValue(),
+                    p.sendtic.ToDebuggingValue(), 0, inflightPktMap.size());
             if (p.seq > maxSeqAckPkt.seq || maxSeqAckPkt.seq == MAX_SEQNUMBER)
             {
                 AckedPacket ackpkt;
@@ -113,26 +349,22 @@ public:
         {
             SPDLOG_WARN("Receive a pkt with unknown seq {}", p.seq);
         }
-
-
-        SPDLOG_TRACE("Recv seq:{}, map now:{}", p.seq, DebugInfo());
     }
 
     // packet is marked as lost
     void RemoveFromInFlight(InflightPacket& p)
     {
-        auto&& itor = inflightPktMap.find(std::make_pair(p.seq, p.pieceId));
-        if (itor != inflightPktMap.end())
+        if (FindPkt(p.seq, p.pieceId))
         {
-            inflightPktMap.erase(std::make_pair(p.seq, p.pieceId));
-            SPDLOG_DEBUG("remove pkt with seq = {}, max inflight {}, max acked {}", p.seq,
-                    MaxSeqInflightPkt().DebugInfo(), MaxSeqAckedPkt().DebugInfo());
+            inflightPktMap.Erase(p.seq);
+            PopDeadSendOrder();
+            DEMO_TRACE_INFLIGHT(TraceEvent::pktRemoved, p.seq, p.pieceId, 0,
+                    p.sendtic.ToDebuggingValue(), 0, inflightPktMap.size());
         }
         else
         {
             SPDLOG_WARN("Remove a pkt with unknown seq {}", p.seq);
         }
-        SPDLOG_TRACE("remove seq:{}, map now:{}", p.seq, DebugInfo());
     }
 
     size_t InFlightPktNum() const
@@ -155,24 +387,36 @@ public:
 
 
     /// return <true,found pkt> or <false,InflightPacket()>
+    /// if dataid is MAX_DATANUMBER, the packet is matched by seq only
     std::pair<bool, InflightPacket> PktIsInFlight(SeqNumber seq, DataNumber dataid = MAX_DATANUMBER)
     {
         std::pair<bool, InflightPacket> rt = std::make_pair(false, InflightPacket());
-        const auto& itor = inflightPktMap.find(std::make_pair(seq, dataid));
-        if (itor != inflightPktMap.end())
+        const auto* pkt = FindPkt(seq, dataid);
+        if (pkt)
         {
-            if (dataid != MAX_DATANUMBER && dataid != itor->second.pieceId)
-            {
-                SPDLOG_WARN("seq {} found, but data id is different. Input dataid: {}, found dataid:{}",
-                        seq, dataid, itor->second.pieceId);
-            }
             rt.first = true;
-            rt.second = itor->second;
+            rt.second = *pkt;
         }
         SPDLOG_TRACE("seq:{}", seq);
         return rt;
     }
 
+    /// Visit in-flight packets from the earliest sent one, as long as visitor returns true.
+    /// Loss detection stops at the first packet that has not expired, so the cost grows with the number
+    /// of lost packets instead of the number of packets in flight.
+    template <typename Visitor>
+    void VisitInSendOrder(Visitor&& visitor) const
+    {
+        for (size_t i = m_sendOrderHead; i < m_sendOrder.size(); ++i)
+        {
+            const auto* pkt = LiveSendOrderPkt(m_sendOrder[i]);
+            if (pkt && !visitor(*pkt))
+            {
+                break;
+            }
+        }
+    }
+
     std::string DebugInfo() const
     {
         std::stringstream ss;
@@ -187,6 +431,72 @@ public:
 
     AckedPacket maxSeqAckPkt;
     InflightPacket maxSeqInflightPkt;
-    using InFlKeyType = std::pair<SeqNumber, DataNumber>;
-    std::map<InFlKeyType, InflightPacket> inflightPktMap;
-};
\ No newline at end of file
+    SeqIndexedRing<InflightPacket> inflightPktMap;
+
+private:
+    struct SendOrderEntry
+    {
+        Timepoint sendtic{ Timepoint::Zero() };
+        SeqNumber seq{ MAX_SEQNUMBER };
+    };
+
+    /// packets are sent in time order, so this is nearly always a push back
+    void AddToSendOrder(const InflightPacket& pkt)
+    {
+        SendOrderEntry entry;
+        entry.sendtic = pkt.sendtic;
+        entry.seq = pkt.seq;
+        if (m_sendOrderHead == m_sendOrder.size() || m_sendOrder.back().sendtic <= pkt.sendtic)
+        {
+            m_sendOrder.push_back(entry);
+            return;
+        }
+        auto pos = std::upper_bound(m_sendOrder.begin() + m_sendOrderHead, m_sendOrder.end(), entry,
+                [](const SendOrderEntry& lhs, const SendOrderEntry& rhs)
+                {
+                    return lhs.sendtic < rhs.sendtic;
+                });
+        m_sendOrder.insert(pos, entry);
+    }
+
+    /// entries of acked or lost packets are dropped lazily once they reach the front
+    void PopDeadSendOrder()
+    {
+        while (m_sendOrderHead < m_sendOrder.size() && !LiveSendOrderPkt(m_sendOrder[m_sendOrderHead]))
+        {
+            ++m_sendOrderHead;
+        }
+        if (m_sendOrderHead == m_sendOrder.size())
+        {
+            m_sendOrder.clear();
+            m_sendOrderHead = 0;
+        }
+        else if (m_sendOrderHead >= 64 && m_sendOrderHead * 2 >= m_sendOrder.size())
+        {
+            // compact in place, keeps the capacity
+            m_sendOrder.erase(m_sendOrder.begin(), m_sendOrder.begin() + m_sendOrderHead);
+            m_sendOrderHead = 0;
+        }
+    }
+
+    const InflightPacket* LiveSendOrderPkt(const SendOrderEntry& entry) const
+    {
+        const auto* pkt = inflightPktMap.Find(entry.seq);
+        return (pkt && pkt->sendtic == entry.sendtic) ? pkt : nullptr;
+    }
+
+    const InflightPacket* FindPkt(SeqNumber seq, DataNumber dataid) const
+    {
+        const auto* pkt = inflightPktMap.Find(seq);
+        if (pkt && dataid != MAX_DATANUMBER && dataid != pkt->pieceId)
+        {
+            SPDLOG_WARN("seq {} found, but data id is different. Input dataid: {}, found dataid:{}",
+                    seq, dataid, pkt->pieceId);
+            return nullptr;
+        }
+        return pkt;
+    }
+
+    std::vector<SendOrderEntry> m_sendOrder;/** in-flight packets ordered by send time, oldest first*/
+    size_t m_sendOrderHead{ 0 };
+};
@@ -0,0 +1,284 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <vector>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "packettype.h"
+
+/** A set of piece numbers kept as a bitmap of 64-piece words, from the word of the lowest piece to the word of the
+ *  highest one. The task queues hold runs of consecutive pieces taken from the low end: a std::set spends a tree
+ *  node of some 48 bytes on each piece, this spends a bit, so the 1M pieces of a 1GB file fit in 128KB.
+ *  The first and last words are never zero, the lowest piece is then one count-trailing-zeros away, and the words
+ *  emptied at the low end are popped as pieces are taken, so taking the lowest n pieces is O(n) amortized.
+ *  Words are scanned 64 pieces at a time with the ctz and popcount builtins.
+ * */
+class PieceSet
+{
+public:
+    /// visits the pieces in ascending order. It holds a piece number, not a position, so erasing the piece it is at
+    /// or any lower one doesn't invalidate it
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = DataNumber;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const DataNumber*;
+        using reference = DataNumber;
+
+        const_iterator(const PieceSet* set, int64_t pno) : m_set(set), m_pno(pno)
+        {
+        }
+
+        DataNumber operator*() const
+        {
+            return static_cast<DataNumber>(m_pno);
+        }
+
+        const_iterator& operator++()
+        {
+            m_pno = m_set->NextFrom(m_pno + 1);
+            return *this;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return m_pno != other.m_pno;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return m_pno == other.m_pno;
+        }
+
+    private:
+        const PieceSet* m_set;
+        int64_t m_pno;/** kEnd past the highest piece*/
+    };
+
+    /// @return false if pno is already in the set, or too far from the pieces in it
+    bool Insert(DataNumber pno)
+    {
+        if (!Cover(WordOf(pno), WordOf(pno)))
+        {
+            return false;
+        }
+        uint64_t& bits = m_words[WordOf(pno) - m_baseWord];
+        if (bits & BitOf(pno))
+        {
+            return false;
+        }
+        bits |= BitOf(pno);
+        ++m_size;
+        return true;
+    }
+
+    template <typename InputIt>
+    void Insert(InputIt first, InputIt last)
+    {
+        for (; first != last; ++first)
+        {
+            Insert(*first);
+        }
+    }
+
+    /// insert the pieces from first to last, both included, a word at a time. @return the pieces that were new
+    size_t InsertRange(DataNumber first, DataNumber last)
+    {
+        if (first > last || !Cover(WordOf(first), WordOf(last)))
+        {
+            return 0;
+        }
+        size_t added = 0;
+        for (int64_t word = WordOf(first); word <= WordOf(last); ++word)
+        {
+            uint64_t mask = ~uint64_t(0);
+            if (word == WordOf(first))
+            {
+                mask &= ~uint64_t(0) << (first & 63);
+            }
+            if (word == WordOf(last))
+            {
+                mask &= ~uint64_t(0) >> (63 - (last & 63));
+            }
+            uint64_t& bits = m_words[word - m_baseWord];
+            added += __builtin_popcountll(mask & ~bits);
+            bits |= mask;
+        }
+        m_size += added;
+        return added;
+    }
+
+    /// @return false if pno is not in the set
+    bool Erase(DataNumber pno)
+    {
+        if (!Contains(pno))
+        {
+            return false;
+        }
+        m_words[WordOf(pno) - m_baseWord] &= ~BitOf(pno);
+        --m_size;
+        Trim();
+        return true;
+    }
+
+    bool Contains(DataNumber pno) const
+    {
+        int64_t word = WordOf(pno);
+        if (m_words.empty() || word < m_baseWord || word > LastWord())
+        {
+            return false;
+        }
+        return (m_words[word - m_baseWord] & BitOf(pno)) != 0;
+    }
+
+    /// the lowest piece, only meaningful if not empty
+    DataNumber Lowest() const
+    {
+        return static_cast<DataNumber>(m_baseWord * 64 + __builtin_ctzll(m_words.front()));
+    }
+
+    /// move the lowest cnt pieces, or all of them if fewer, to the back of out. @return the pieces moved
+    size_t PopLowest(size_t cnt, std::vector<DataNumber>& out)
+    {
+        size_t popped = 0;
+        while (popped < cnt && m_size > 0)
+        {
+            uint64_t& bits = m_words.front();
+            while (bits != 0 && popped < cnt)
+            {
+                out.push_back(static_cast<DataNumber>(m_baseWord * 64 + __builtin_ctzll(bits)));
+                bits &= bits - 1;
+                ++popped;
+                --m_size;
+            }
+            Trim();
+        }
+        return popped;
+    }
+
+    void Clear()
+    {
+        m_words.clear();
+        m_size = 0;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, m_size == 0 ? kEnd : Lowest());
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, kEnd);
+    }
+
+private:
+    static constexpr int64_t kEnd = INT64_MAX;
+    static constexpr int64_t kMaxSpanWords = int64_t(1) << 18;/** 16M pieces, guard against a wild piece number*/
+
+    static int64_t WordOf(int64_t pno)
+    {
+        return pno >> 6;
+    }
+
+    static uint64_t BitOf(int64_t pno)
+    {
+        return uint64_t(1) << (pno & 63);
+    }
+
+    int64_t LastWord() const
+    {
+        return m_baseWord + static_cast<int64_t>(m_words.size()) - 1;
+    }
+
+    /// the lowest piece no less than pno, kEnd if there is none
+    int64_t NextFrom(int64_t pno) const
+    {
+        if (m_size == 0 || WordOf(pno) > LastWord())
+        {
+            return kEnd;
+        }
+        if (WordOf(pno) < m_baseWord)
+        {
+            pno = m_baseWord * 64;
+        }
+        size_t idx = static_cast<size_t>(WordOf(pno) - m_baseWord);
+        uint64_t bits = m_words[idx] & (~uint64_t(0) << (pno & 63));
+        while (bits == 0)
+        {
+            if (++idx == m_words.size())
+            {
+                return kEnd;
+            }
+            bits = m_words[idx];
+        }
+        return (m_baseWord + static_cast<int64_t>(idx)) * 64 + __builtin_ctzll(bits);
+    }
+
+    /// grow the bitmap so that it spans the words from lo to hi. @return false if it would get too long
+    bool Cover(int64_t lo, int64_t hi)
+    {
+        if (m_words.empty())
+        {
+            if (hi - lo >= kMaxSpanWords)
+            {
+                SPDLOG_WARN("pieces {} to {} span too many words", lo * 64, hi * 64 + 63);
+                return false;
+            }
+            m_baseWord = lo;
+            m_words.resize(static_cast<size_t>(hi - lo + 1), 0);
+            return true;
+        }
+        int64_t newLo = lo < m_baseWord ? lo : m_baseWord;
+        int64_t newHi = hi > LastWord() ? hi : LastWord();
+        if (newHi - newLo >= kMaxSpanWords)
+        {
+            SPDLOG_WARN("pieces {} to {} are too far from base piece {}", lo * 64, hi * 64 + 63, m_baseWord * 64);
+            return false;
+        }
+        m_words.insert(m_words.begin(), static_cast<size_t>(m_baseWord - newLo), 0);
+        m_baseWord = newLo;
+        m_words.resize(static_cast<size_t>(newHi - newLo + 1), 0);
+        return true;
+    }
+
+    /// drop the zero words at both ends, each word is dropped at most once after it was added
+    void Trim()
+    {
+        if (m_size == 0)
+        {
+            m_words.clear();
+            return;
+        }
+        while (m_words.front() == 0)
+        {
+            m_words.pop_front();
+            ++m_baseWord;
+        }
+        while (m_words.back() == 0)
+        {
+            m_words.pop_back();
+        }
+    }
+
+    std::deque<uint64_t> m_words;/** bit i of m_words[k] is piece (m_baseWord + k) * 64 + i*/
+    int64_t m_baseWord{ 0 };
+    size_t m_size{ 0 };/** pieces in the set*/
+};
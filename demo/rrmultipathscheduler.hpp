@@ -5,9 +5,11 @@
 
 #include <vector>
 #include <set>
+#include <cmath>
 #include "basefw/base/log.h"
 #include "multipathschedulerI.h"
-#include <numeric>
+#include "sessionranking.hpp"
+#include <limits>
 
 
 /// min RTT Round Robin multipath scheduler
@@ -20,8 +22,8 @@ public:
     }
 
     explicit RRMultiPathScheduler(const fw::ID& taskid,
-            std::map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
-            std::set<DataNumber>& downloadQueue, std::set<int32_t>& lostPiecesQueue)
+            std::unordered_map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
+            PieceSet& downloadQueue, PieceSet& lostPiecesQueue)
             : MultiPathSchedulerAlgo(taskid, dlsessionmap, downloadQueue, lostPiecesQueue)
     {
         SPDLOG_DEBUG("taskid :{}", taskid.ToLogStr());
@@ -29,7 +31,8 @@ public:
 
     ~RRMultiPathScheduler() override
     {
-        SPDLOG_TRACE("");
+        SPDLOG_DEBUG("scheduling events: {} passes: {} data requests: {} pieces per request: {}", m_eventCnt, m_passCnt,
+                m_requestCnt, GetPiecesPerRequest());
     }
 
     int32_t StartMultiPathScheduler(fw::weak_ptr<MultiPathSchedulerHandler> mpsHandler) override
@@ -53,18 +56,22 @@ public:
         if (itor != m_session_needdownloadpieceQ.end())
         {// found, clear the sending queue
             SPDLOG_WARN("Session: {} is already created", sessionid.ToLogStr());
-            for (auto&& subpiecetask: itor->second)
-            {
-                m_downloadQueue.emplace(subpiecetask);
-            }
+            m_downloadQueue.Insert(itor->second.begin(), itor->second.end());
         }
-        m_session_needdownloadpieceQ[sessionid] = std::set<int32_t>();
+        m_session_needdownloadpieceQ[sessionid].Clear();
+        auto&& itor_sess = m_dlsessionmap.find(sessionid);
+        if (itor_sess != m_dlsessionmap.end() && itor_sess->second)
+        {
+            m_rttRanking.Insert(sessionid, itor_sess->second, itor_sess->second->GetRtt());
+        }
+        m_dirty = true;
 
     }
 
     void OnSessionDestory(const fw::ID& sessionid) override
     {
         SPDLOG_DEBUG("session: {}", sessionid.ToLogStr());
+        m_rttRanking.Erase(sessionid);
         // find the session's queue, clear the subpieces and add the subpieces to main downloading queue
         auto&& itor = m_session_needdownloadpieceQ.find(sessionid);
         if (itor == m_session_needdownloadpieceQ.end())
@@ -72,17 +79,24 @@ public:
             SPDLOG_WARN("Session: {} isn't in session queue", sessionid.ToLogStr());
             return;
         }
-        for (auto&& subpiecetask: itor->second)
-        {
-            m_downloadQueue.emplace(subpiecetask);
-
-        }
+        m_downloadQueue.Insert(itor->second.begin(), itor->second.end());
         m_session_needdownloadpieceQ.erase(itor);
+        m_pendingWnd.erase(sessionid);
+        m_lastWndOpenTic.erase(sessionid);
+        m_batchSince.erase(sessionid);
+        m_dirty = true;
     }
 
     void OnResetDownload() override
     {
         SPDLOG_DEBUG("");
+        m_pendingWnd.clear();
+        m_lastWndOpenTic.clear();
+        m_batchSince.clear();
+        m_rttRanking.Clear();
+        m_tasksAdded = false;
+        m_dirty = false;
+        m_timerTic = Timepoint::Zero();
 
         if (m_session_needdownloadpieceQ.empty())
         {
@@ -92,9 +106,9 @@ public:
         {
             if (!it_sn.second.empty())
             {
-                m_downloadQueue.insert(it_sn.second.begin(), it_sn.second.end());
+                m_downloadQueue.Insert(it_sn.second.begin(), it_sn.second.end());
 
-                it_sn.second.clear();
+                it_sn.second.Clear();
             }
         }
         m_session_needdownloadpieceQ.clear();
@@ -108,9 +122,7 @@ public:
             SPDLOG_DEBUG("Empty session map");
             return;
         }
-        // sort session first
         SPDLOG_TRACE("DoMultiPathSchedule");
-        SortSession(m_sortmmap);
         // send pkt requests on each session based on ascend order;
         FillUpSessionTask();
 
@@ -120,13 +132,16 @@ public:
     uint32_t DoSinglePathSchedule(const fw::ID& sessionid) override
     {
         SPDLOG_DEBUG("session:{}", sessionid.ToLogStr());
-        // if key doesn't map to a valid set, []operator should create an empty set for us
-        auto& session = m_dlsessionmap[sessionid];
-        if (!session)
+        auto&& itor_sess = m_dlsessionmap.find(sessionid);
+        auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(sessionid);
+        if (itor_sess == m_dlsessionmap.end() || !itor_sess->second ||
+            itor_id_ssQ == m_session_needdownloadpieceQ.end())
         {
             SPDLOG_WARN("Unknown session: {}", sessionid.ToLogStr());
             return -1;
         }
+        auto& session = itor_sess->second;
+        auto& sessQueue = itor_id_ssQ->second;
 
         auto uni32DataReqCnt = session->CanRequestPktCnt();
         SPDLOG_DEBUG("Free Wnd : {}", uni32DataReqCnt);
@@ -136,13 +151,17 @@ public:
             SPDLOG_WARN("Free Wnd equals to 0");
             return -1;
         }
+        StealQueuedPieces();
+        // ask for the pieces of a request held back too, to have them at hand once it is filled
+        uint32_t wantedCnt = FreeWndBeyondQueue(session, sessQueue.size());
+        uni32DataReqCnt = BatchedFreeWnd(sessionid, session, sessQueue.size());
 
-        if (m_downloadQueue.size() < uni32DataReqCnt)
+        if (m_downloadQueue.size() < wantedCnt)
         {
             auto handler = m_phandler.lock();
             if (handler)
             {
-                handler->OnRequestDownloadPieces(uni32DataReqCnt - m_downloadQueue.size());
+                handler->OnRequestDownloadPieces(wantedCnt - m_downloadQueue.size());
             }
             else
             {
@@ -153,14 +172,14 @@ public:
         /// Add task to session task queue
         std::vector<int32_t> vecSubpieceNums;
         // eject uni32DataReqCnt number of subpieces from
-        for (auto itr = m_downloadQueue.begin(); itr != m_downloadQueue.end() && uni32DataReqCnt > 0;)
+        uni32DataReqCnt -= m_downloadQueue.PopLowest(uni32DataReqCnt, vecSubpieceNums);
+        if (uni32DataReqCnt > 0)
         {
-            vecSubpieceNums.push_back(*itr);
-            m_downloadQueue.erase(itr++);
-            --uni32DataReqCnt;
+            // ran out of pieces before the window is full
+            session->OnAppLimited();
         }
 
-        m_session_needdownloadpieceQ[sessionid].insert(vecSubpieceNums.begin(), vecSubpieceNums.end());
+        sessQueue.Insert(vecSubpieceNums.begin(), vecSubpieceNums.end());
 
         ////////////////////////////////////DoSendRequest
         DoSendSessionSubTask(sessionid);
@@ -172,12 +191,33 @@ public:
         SPDLOG_DEBUG("session {},lost pieces {}", sessionid.ToLogStr(), pns);
         for (auto& pidx: pns)
         {
-            auto&& itor_pair = m_lostPiecesQueue.emplace(pidx);
-            if (!itor_pair.second)
+            if (!m_lostPiecesQueue.Insert(pidx))
             {
                 SPDLOG_WARN(" pieceId {} already marked lost", pidx);
             }
         }
+        m_dirty = true;
+    }
+
+    void OnSpuriousLoss(const fw::ID& sessionid, DataNumber pno) override
+    {
+        SPDLOG_DEBUG("session {}, late piece {}", sessionid.ToLogStr(), pno);
+        if (m_lostPiecesQueue.Erase(pno))
+        {
+            return;
+        }
+        // FillUpSessionTask may have moved it on already, but not sent it yet
+        if (m_downloadQueue.Erase(pno))
+        {
+            return;
+        }
+        for (auto&& it_sn: m_session_needdownloadpieceQ)
+        {
+            if (it_sn.second.Erase(pno))
+            {
+                return;
+            }
+        }
     }
 
     void OnReceiveSubpieceData(const fw::ID& sessionid, SeqNumber seq, DataNumber pno, Timepoint recvtime) override
@@ -185,69 +225,431 @@ public:
         SPDLOG_DEBUG("session:{}, seq:{}, pno:{}, recvtime:{}",
                 sessionid.ToLogStr(), seq, pno, recvtime.ToDebuggingValue());
         /// rx and tx signal are forwarded directly from transport controller to session controller
+        SessionRanking::Ranked* ranked = m_rttRanking.Find(sessionid);
+        if (ranked)
+        {
+            // its RTT has just been sampled
+            m_rttRanking.Update(*ranked, ranked->session->GetRtt());
+        }
 
-        DoSinglePathSchedule(sessionid);
+        OnWindowOpened(sessionid, 1);
     }
 
-    void SortSession(std::multimap<Duration, fw::shared_ptr<SessionStreamController>>& sortmmap) override
+    /** The window opened by a burst of acks, those processed within kCoalesceDelayUs of each other, is sent in one
+     *  scheduling pass rather than one per ack. The first ack of a burst is scheduled at once, the window opened by
+     *  the following ones is held back until the session has a full request of it, or the pieces still in flight
+     *  on it are too few to open that much, or it has waited kCoalesceDelayUs. Acks spread further apart than that
+     *  are each scheduled at once, as is any window when lost pieces are waiting. Window held back is flushed by the
+     *  schedule timer kCoalesceDelayUs after it first opened, should no later event run a pass before.
+     * */
+    void OnWindowOpened(const fw::ID& sessionid, uint32_t cnt) override
     {
-        SPDLOG_TRACE("");
-        sortmmap.clear();
-        for (auto&& sessionItor: m_dlsessionmap)
+        ++m_eventCnt;
+        Timepoint now = Clock::GetClock()->Now();
+        if (m_pendingWnd.empty())
         {
-            auto score = sessionItor.second->GetRtt();
-            sortmmap.emplace(score, sessionItor.second);
+            m_pendingSince = now;
         }
+        uint32_t& pendingCnt = m_pendingWnd[sessionid];
+        pendingCnt += cnt;
+        bool inBurst = false;
+        auto&& itor_last = m_lastWndOpenTic.find(sessionid);
+        if (itor_last == m_lastWndOpenTic.end())
+        {
+            m_lastWndOpenTic.emplace(sessionid, now);
+        }
+        else
+        {
+            inBurst = (now - itor_last->second).ToMicroseconds() < kCoalesceDelayUs;
+            itor_last->second = now;
+        }
+        if (m_inPass)
+        {
+            return;
+        }
+        auto&& itor = m_dlsessionmap.find(sessionid);
+        if (!inBurst || m_dirty || !m_lostPiecesQueue.empty() || pendingCnt >= kCoalescePieces ||
+            itor == m_dlsessionmap.end() || !itor->second ||
+            itor->second->GetInFlightPktNum() < kCoalescePieces ||
+            (now - m_pendingSince).ToMicroseconds() >= kCoalesceDelayUs)
+        {
+            RunSchedulePass();
+        }
+        else
+        {
+            ArmScheduleTimer(m_pendingSince + Duration::FromMicroseconds(kCoalesceDelayUs));
+        }
+    }
 
+    void OnTasksAdded(uint32_t cnt) override
+    {
+        SPDLOG_TRACE("{} pieces added", cnt);
+        ++m_eventCnt;
+        m_tasksAdded = true;
+        if (m_inPass)
+        {
+            // the pass that asked for them hands them out
+            return;
+        }
+        if (HasFreeWnd())
+        {
+            RunSchedulePass();
+        }
     }
 
-private:
+    void OnScheduleAlarm() override
+    {
+        if (m_inPass)
+        {
+            return;
+        }
+        // a window may also open as the pacer lets more pieces go
+        if (m_dirty || !m_pendingWnd.empty() || !m_lostPiecesQueue.empty() || HasFreeWnd())
+        {
+            RunSchedulePass();
+        }
+        else
+        {
+            SPDLOG_TRACE("nothing changed since the last pass");
+        }
+    }
+
+    void OnScheduleTimer() override
+    {
+        m_timerTic = Timepoint::Zero();
+        if (m_inPass)
+        {
+            // the pass under way arms the timer again for what it leaves held back
+            return;
+        }
+        // armed for any of the sessions
+        m_dirty = true;
+        RunSchedulePass();
+    }
+
+protected:
     int32_t DoSendSessionSubTask(const fw::ID& sessionid) override
     {
         SPDLOG_TRACE("session id: {}", sessionid.ToLogStr());
         int32_t i32Result = -1;
-        auto& setNeedDlSubpiece = m_session_needdownloadpieceQ[sessionid];
-        if (setNeedDlSubpiece.empty())
+        auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(sessionid);
+        if (itor_id_ssQ == m_session_needdownloadpieceQ.end() || itor_id_ssQ->second.empty())
         {
             SPDLOG_TRACE("empty sending queue");
             return i32Result;
         }
+        auto& setNeedDlSubpiece = itor_id_ssQ->second;
 
-        auto& session = m_dlsessionmap[sessionid];
-        uint32_t u32CanSendCnt = session->CanRequestPktCnt();
-        std::vector<int32_t> vecSubpieces;
-        for (auto itor = setNeedDlSubpiece.begin();
-             itor != setNeedDlSubpiece.end() && vecSubpieces.size() < u32CanSendCnt;)
+        auto&& itor_sess = m_dlsessionmap.find(sessionid);
+        if (itor_sess == m_dlsessionmap.end() || !itor_sess->second)
         {
-            vecSubpieces.emplace_back(*itor);
-            setNeedDlSubpiece.erase(itor++);
+            SPDLOG_WARN("Unknown session: {}", sessionid.ToLogStr());
+            return i32Result;
         }
+        auto& session = itor_sess->second;
+        uint32_t u32CanSendCnt = session->CanRequestPktCnt();
+        std::vector<int32_t> vecSubpieces;
+        setNeedDlSubpiece.PopLowest(u32CanSendCnt, vecSubpieces);
 
-        bool rt = m_dlsessionmap[sessionid]->DoRequestdata(sessionid, vecSubpieces);
-        if (rt)
+        // a data request carries either 1 piece or 8, the 8 being a run of consecutive piece numbers. The pieces
+        // not in such a run go one per request
+        size_t sentCnt = 0;
+        std::vector<int32_t> vecRequest;
+        while (sentCnt < vecSubpieces.size())
         {
-            i32Result = 0;
+            size_t reqCnt = 1;
+            while (reqCnt < kPiecesPerRequest && sentCnt + reqCnt < vecSubpieces.size() &&
+                   vecSubpieces[sentCnt + reqCnt] == vecSubpieces[sentCnt + reqCnt - 1] + 1)
+            {
+                ++reqCnt;
+            }
+            if (reqCnt < kPiecesPerRequest)
+            {
+                reqCnt = 1;
+            }
+            vecRequest.assign(vecSubpieces.begin() + sentCnt, vecSubpieces.begin() + sentCnt + reqCnt);
+            if (!session->DoRequestdata(sessionid, vecRequest))
+            {
+                break;
+            }
             //succeed
+            i32Result = 0;
+            ++m_requestCnt;
+            m_requestedPieceCnt += reqCnt;
+            OnPiecesRequested(sessionid, vecRequest);
+            sentCnt += reqCnt;
         }
-        else
+        if (sentCnt < vecSubpieces.size())
         {
             // fail
-            // return sending pieces to main download queue
-            SPDLOG_DEBUG("Send failed, Given back");
-            m_downloadQueue.insert(setNeedDlSubpiece.begin(), setNeedDlSubpiece.end());
+            // keep the pieces queued on the session, an idle session may steal them
+            SPDLOG_DEBUG("Send failed, kept in session queue");
+            setNeedDlSubpiece.Insert(vecSubpieces.begin() + sentCnt, vecSubpieces.end());
+            m_dirty = true;
         }
 
         return i32Result;
     }
 
-    void FillUpSessionTask()
+    /** One scheduling pass for the events since the last one. The window opened on a single session is filled by
+     *  DoSinglePathSchedule, anything else takes a full DoMultiPathSchedule: windows opened on several sessions,
+     *  added tasks, lost pieces, sessions created or destroyed, or a failed request.
+     * */
+    void RunSchedulePass()
+    {
+        bool full = m_dirty || m_tasksAdded || m_pendingWnd.size() != 1 || !m_lostPiecesQueue.empty();
+        fw::ID sessionid = m_pendingWnd.empty() ? fw::ID() : m_pendingWnd.begin()->first;
+        m_pendingWnd.clear();
+        m_tasksAdded = false;
+        m_dirty = false;
+        m_inPass = true;
+        ++m_passCnt;
+        if (full)
+        {
+            DoMultiPathSchedule();
+        }
+        else
+        {
+            DoSinglePathSchedule(sessionid);
+        }
+        m_inPass = false;
+
+        // the pacer lets the pieces it held back go with time, not with an ack
+        if (full)
+        {
+            for (auto&& ranked: m_rttRanking)
+            {
+                ArmPacerTimer(ranked->sessionid, ranked->session);
+            }
+        }
+        else
+        {
+            SessionRanking::Ranked* ranked = m_rttRanking.Find(sessionid);
+            if (ranked)
+            {
+                ArmPacerTimer(sessionid, ranked->session);
+            }
+        }
+    }
+
+    /// have OnScheduleTimer called at deadline, unless it is armed for an earlier one already
+    void ArmScheduleTimer(Timepoint deadline)
+    {
+        if (m_timerTic.IsInitialized() && m_timerTic <= deadline)
+        {
+            return;
+        }
+        auto handler = m_phandler.lock();
+        if (handler)
+        {
+            m_timerTic = deadline;
+            handler->ArmScheduleTimer(deadline);
+        }
+    }
+
+    /** arm the schedule timer for when the pacer gives session a token, if its window is open and there are pieces
+     *  it could request. Without the timer they would wait for the next ack or alarm.
+     * */
+    void ArmPacerTimer(const fw::ID& sessionid, const fw::shared_ptr<SessionStreamController>& session)
+    {
+        auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(sessionid);
+        bool hasQueued = itor_id_ssQ != m_session_needdownloadpieceQ.end() && !itor_id_ssQ->second.empty();
+        if (!hasQueued && m_downloadQueue.empty() && m_lostPiecesQueue.empty())
+        {
+            return;
+        }
+        Timepoint nextSendTic = session->NextSendTime();
+        if (nextSendTic != Timepoint::Infinite() && nextSendTic > Clock::GetClock()->Now())
+        {
+            ArmScheduleTimer(nextSendTic);
+        }
+    }
+
+    /// some session has free window beyond its queue
+    bool HasFreeWnd()
+    {
+        for (auto&& id_sess: m_dlsessionmap)
+        {
+            auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(id_sess.first);
+            if (id_sess.second && itor_id_ssQ != m_session_needdownloadpieceQ.end() &&
+                BatchedFreeWnd(id_sess.first, id_sess.second, itor_id_ssQ->second.size()) > 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// pieces have just been requested on session
+    virtual void OnPiecesRequested(const fw::ID& sessionid, const std::vector<DataNumber>& pieces)
+    {
+    }
+
+    /** pieces per second the session is expected to deliver. The max delivery rate underestimates a path that
+     *  has been starved of pieces, the window over the RTT is what its cc would let through then.
+     * */
+    static double ExpectedRate(const fw::shared_ptr<SessionStreamController>& session)
+    {
+        double rate = std::max(session->GetMaxBandwidth(), session->GetWindowRate());
+        return rate > kMinExpectedRate ? rate : kMinExpectedRate;
+    }
+
+    /** free window of session that its queued pieces won't take. The queues are sent as soon as they are filled,
+     *  a session that still holds pieces it has window for failed to request them and gets no more
+     * */
+    static uint32_t FreeWndBeyondQueue(const fw::shared_ptr<SessionStreamController>& session, size_t queuedCnt)
+    {
+        uint32_t freeCnt = session->CanRequestPktCnt();
+        if (queuedCnt > 0 && freeCnt >= queuedCnt)
+        {
+            return 0;
+        }
+        return freeCnt > queuedCnt ? freeCnt - static_cast<uint32_t>(queuedCnt) : 0;
+    }
+
+    /** Free window of session to fill now, that of FreeWndBeyondQueue less a part short of a full request, which
+     *  is held back while the acks still due on the session are expected to open the rest of the request within
+     *  the latency budget, min(srtt / 4, kMaxBatchDelayUs) from when it was first held back. It is filled then,
+     *  so the pieces are requested 8 at a time instead of one per ack. The schedule timer is armed for the end of
+     *  the budget, when the window is filled even if no ack comes. A small window takes longer than the budget
+     *  to open a request and is filled as it opens.
+     *  Only a window that the cc or the window cap keeps short is held back. One that the pacer keeps short is
+     *  requested as the tokens come back, on the timer ArmPacerTimer sets.
+     * */
+    uint32_t BatchedFreeWnd(const fw::ID& sessionid, const fw::shared_ptr<SessionStreamController>& session,
+            size_t queuedCnt)
+    {
+        uint32_t freeCnt = FreeWndBeyondQueue(session, queuedCnt);
+        uint32_t partialCnt = static_cast<uint32_t>((queuedCnt + freeCnt) % kPiecesPerRequest);
+        uint32_t inflightCnt = session->GetInFlightPktNum();
+        bool paced = session->GetWindow() > inflightCnt + queuedCnt + freeCnt;
+        if (partialCnt == 0 || partialCnt > freeCnt || paced || inflightCnt + partialCnt < kPiecesPerRequest)
+        {
+            // a whole number of requests, one held up by the pacer, or one that the acks due can't make up
+            m_batchSince.erase(sessionid);
+            return freeCnt;
+        }
+        Timepoint now = Clock::GetClock()->Now();
+        auto&& itor_since = m_batchSince.find(sessionid);
+        if (itor_since == m_batchSince.end())
+        {
+            itor_since = m_batchSince.emplace(sessionid, now).first;
+        }
+        double budgetSec = std::min(session->GetSmoothedOrInitialRtt().ToMicroseconds() / 4.0,
+                static_cast<double>(kMaxBatchDelayUs)) / 1000000.0;
+        double waitedSec = (now - itor_since->second).ToMicroseconds() / 1000000.0;
+        double openSec = (kPiecesPerRequest - partialCnt) / ExpectedRate(session);
+        if (waitedSec + openSec > budgetSec)
+        {
+            m_batchSince.erase(itor_since);
+            return freeCnt;
+        }
+        // filled by then should the acks not come
+        ArmScheduleTimer(itor_since->second +
+                Duration::FromMicroseconds(static_cast<int64_t>(std::ceil((budgetSec - openSec) * 1000000.0)) + 1));
+        SPDLOG_TRACE("session {} holds back {} pieces for a full request", sessionid.ToLogStr(), partialCnt);
+        return freeCnt - partialCnt;
+    }
+
+    /// pieces requested over data requests sent, 0 before the first one
+    double GetPiecesPerRequest() const
+    {
+        return m_requestCnt == 0 ? 0 : static_cast<double>(m_requestedPieceCnt) / m_requestCnt;
+    }
+
+    /** Work stealing between the session queues. A session with free window beyond its queue takes the lowest
+     *  pieces queued on the session whose queue is predicted to complete last, srtt + queued / rate, as long as it
+     *  would deliver them earlier than that. The queue of a session that failed to request it is taken by any
+     *  session with free window. The stolen pieces go back to the download queue, to be handed out with the lower
+     *  ones waiting there.
+     * */
+    void StealQueuedPieces()
+    {
+        // the queues are sent as soon as they are filled, most passes find nothing to steal
+        bool anyQueued = false;
+        for (auto&& id_ssQ: m_session_needdownloadpieceQ)
+        {
+            if (!id_ssQ.second.empty())
+            {
+                anyQueued = true;
+                break;
+            }
+        }
+        if (!anyQueued)
+        {
+            return;
+        }
+
+        struct QueueState
+        {
+            PieceSet* queue;
+            uint32_t freeCnt;
+            double srttSec;
+            double rate;
+            uint32_t stolenCnt;
+        };
+        std::vector<QueueState> states;
+        states.reserve(m_dlsessionmap.size());
+        for (auto&& id_sess: m_dlsessionmap)
+        {
+            auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(id_sess.first);
+            if (!id_sess.second || itor_id_ssQ == m_session_needdownloadpieceQ.end())
+            {
+                continue;
+            }
+            QueueState state;
+            state.queue = &itor_id_ssQ->second;
+            state.freeCnt = id_sess.second->CanRequestPktCnt();
+            state.srttSec = id_sess.second->GetSmoothedOrInitialRtt().ToMicroseconds() / 1000000.0;
+            state.rate = ExpectedRate(id_sess.second);
+            state.stolenCnt = 0;
+            states.push_back(state);
+        }
+
+        for (auto&& thief: states)
+        {
+            while (thief.freeCnt > thief.queue->size() + thief.stolenCnt)
+            {
+                double thiefTime = thief.srttSec + (thief.queue->size() + thief.stolenCnt + 1) / thief.rate;
+                QueueState* victim = nullptr;
+                double victimTime = 0;
+                for (auto&& other: states)
+                {
+                    if (&other == &thief || other.queue->empty())
+                    {
+                        continue;
+                    }
+                    double otherTime = other.srttSec + other.queue->size() / other.rate;
+                    if (other.queue->size() <= other.freeCnt)
+                    {
+                        // it had window for them and failed to request them, the queue waits for nothing
+                        otherTime = std::numeric_limits<double>::infinity();
+                    }
+                    if (!victim || otherTime > victimTime)
+                    {
+                        victim = &other;
+                        victimTime = otherTime;
+                    }
+                }
+                if (!victim || thiefTime >= victimTime)
+                {
+                    break;
+                }
+                DataNumber stolen = victim->queue->Lowest();
+                SPDLOG_TRACE("piece {} stolen, {}s instead of {}s", stolen, thiefTime, victimTime);
+                m_downloadQueue.Insert(stolen);
+                victim->queue->Erase(stolen);
+                ++thief.stolenCnt;
+            }
+        }
+    }
+
+    /// put lost packets back into main download queue
+    void RequeueLostPieces()
     {
-        // 1. put lost packets back into main download queue
-        SPDLOG_TRACE("");
         for (auto&& lostpiece: m_lostPiecesQueue)
         {
-            auto&& itor_pair = m_downloadQueue.emplace(lostpiece);
-            if (itor_pair.second)
+            if (m_downloadQueue.Insert(lostpiece))
             {
                 SPDLOG_TRACE("lost piece {} inserts successfully", lostpiece);
             }
@@ -256,37 +658,42 @@ private:
                 SPDLOG_TRACE("lost piece {} already in task queue", lostpiece);
             }
         }
-        m_lostPiecesQueue.clear();
+        m_lostPiecesQueue.Clear();
+    }
 
-        // 2. go through every session,find how many pieces we can request at one time
+    void FillUpSessionTask()
+    {
+        // 1. put lost packets back into main download queue
+        SPDLOG_TRACE("");
+        RequeueLostPieces();
+        StealQueuedPieces();
 
-        std::map<basefw::ID, uint32_t> toSendinEachSession;
-        for (auto&& itor: m_dlsessionmap)
+        // 2. go through every session,find how many pieces we can request at one time
+        m_toSendCnt.assign(m_rttRanking.size(), 0);
+        uint32_t totalSubpieceCnt = 0;
+        uint32_t totalWantedCnt = 0;/** the requests held back included*/
+        for (auto&& ranked: m_rttRanking)
         {
-            auto& sessionId = itor.first;
-            auto& sessStream = itor.second;
-            auto sessCanSendCnt = sessStream->CanRequestPktCnt();
-            toSendinEachSession.emplace(sessionId, sessCanSendCnt);
+            auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(ranked->sessionid);
+            size_t queuedCnt = itor_id_ssQ == m_session_needdownloadpieceQ.end() ? 0 : itor_id_ssQ->second.size();
+            auto sessCanSendCnt = BatchedFreeWnd(ranked->sessionid, ranked->session, queuedCnt);
+            m_toSendCnt[ranked->pos] = sessCanSendCnt;
+            totalSubpieceCnt += sessCanSendCnt;
+            totalWantedCnt += FreeWndBeyondQueue(ranked->session, queuedCnt);
             if (sessCanSendCnt != 0)
             {
-                SPDLOG_TRACE("session {} has {} free wnd", sessionId.ToLogStr(), sessCanSendCnt);
+                SPDLOG_TRACE("session {} has {} free wnd", ranked->sessionid.ToLogStr(), sessCanSendCnt);
             }
         }
-        uint32_t totalSubpieceCnt = std::accumulate(toSendinEachSession.begin(), toSendinEachSession.end(),
-                0, [](size_t total,
-                        std::pair<const basefw::ID, uint32_t>& session_task_itor)
-                {
-                    return total + session_task_itor.second;
-                });
 
         // 3. try to request enough piece cnt from up layer, if necessary
 
-        if (m_downloadQueue.size() < totalSubpieceCnt)
+        if (m_downloadQueue.size() < totalWantedCnt)
         {
             auto handler = m_phandler.lock();
             if (handler)
             {
-                handler->OnRequestDownloadPieces(totalSubpieceCnt - m_downloadQueue.size());
+                handler->OnRequestDownloadPieces(totalWantedCnt - m_downloadQueue.size());
             }
             else
             {
@@ -298,37 +705,23 @@ private:
 
         // 4. fill up each session Queue, based on min RTT first order, and send
         std::vector<DataNumber> vecToSendpieceNums;
-        for (auto&& rtt_sess: m_sortmmap)
+        for (auto&& ranked: m_rttRanking)
         {
-            auto& sessStream = rtt_sess.second;
-            auto&& sessId = sessStream->GetSessionId();
+            auto& sessStream = ranked->session;
+            auto&& sessId = ranked->sessionid;
             auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(sessId);
             if (itor_id_ssQ != m_session_needdownloadpieceQ.end())
             {
-                auto&& id_sendcnt = toSendinEachSession.find(sessId);
-                if (id_sendcnt != toSendinEachSession.end())
-                {
-                    auto uni32DataReqCnt = toSendinEachSession.at(sessId);
-                    for (auto&& itr = m_downloadQueue.begin();
-                         itr != m_downloadQueue.end() && uni32DataReqCnt > 0;)
-                    {
-
-                        vecToSendpieceNums.push_back(*itr);
-                        m_downloadQueue.erase(itr++);
-                        --uni32DataReqCnt;
-
-                    }
-
-                    m_session_needdownloadpieceQ[sessId].insert(vecToSendpieceNums.begin(),
-                            vecToSendpieceNums.end());
-                    vecToSendpieceNums.clear();
-                }
-                else
+                auto uni32DataReqCnt = m_toSendCnt[ranked->pos];
+                uni32DataReqCnt -= m_downloadQueue.PopLowest(uni32DataReqCnt, vecToSendpieceNums);
+                if (uni32DataReqCnt > 0)
                 {
-                    SPDLOG_ERROR("Can't found session {} in toSendinEachSession", sessId.ToLogStr());
+                    // ran out of pieces before the window is full
+                    sessStream->OnAppLimited();
                 }
 
-
+                itor_id_ssQ->second.Insert(vecToSendpieceNums.begin(), vecToSendpieceNums.end());
+                vecToSendpieceNums.clear();
             }
             else
             {
@@ -336,22 +729,43 @@ private:
             }
         }
 
-        // then send in each session
-        for (auto&& it_sn = m_session_needdownloadpieceQ.begin();
-             it_sn != m_session_needdownloadpieceQ.end(); ++it_sn)
+        // then send in each session, in the same order
+        for (auto&& ranked: m_rttRanking)
         {
-            auto& sessId = it_sn->first;
-            auto& sessQueue = it_sn->second;
-            SPDLOG_TRACE("session Id:{}, session queue:{}", sessId.ToLogStr(), sessQueue);
-            DoSendSessionSubTask(it_sn->first);
+            auto&& itor_id_ssQ = m_session_needdownloadpieceQ.find(ranked->sessionid);
+            if (itor_id_ssQ != m_session_needdownloadpieceQ.end())
+            {
+                SPDLOG_TRACE("session Id:{}, session queue:{}", ranked->sessionid.ToLogStr(), itor_id_ssQ->second);
+            }
+            DoSendSessionSubTask(ranked->sessionid);
         }
 
 
     }// end of FillUpSessionTask
 
-    /// It's multipath scheduler's duty to maintain session_needdownloadsubpiece, and m_sortmmap
-    std::map<fw::ID, std::set<DataNumber>> m_session_needdownloadpieceQ;// session task queues
-    std::multimap<Duration, fw::shared_ptr<SessionStreamController>> m_sortmmap;
+    static constexpr double kMinExpectedRate = 1.0;/** pieces per second, keeps an unmeasured path finite*/
+    static constexpr uint32_t kCoalescePieces = 8;/** free window worth a pass of its own, a full request*/
+    static constexpr int64_t kCoalesceDelayUs = 1000;/** acks closer than that are a burst, sharing a pass*/
+    static constexpr uint32_t kPiecesPerRequest = 8;/** pieces of a full data request*/
+    static constexpr int64_t kMaxBatchDelayUs = 2000;/** a partial request is held back for that long at most*/
+
+    std::unordered_map<fw::ID, uint32_t> m_pendingWnd;/** window opened on each session since the last pass*/
+    Timepoint m_pendingSince{ Timepoint::Zero() };/** when the first window of m_pendingWnd opened*/
+    std::unordered_map<fw::ID, Timepoint> m_lastWndOpenTic;/** the latest ack of each session*/
+    bool m_tasksAdded{ false };/** pieces added to the download queue since the last pass*/
+    bool m_dirty{ false };/** the last pass is outdated by more than window opened, a full one is due*/
+    bool m_inPass{ false };
+    uint64_t m_eventCnt{ 0 };
+    uint64_t m_passCnt{ 0 };
+    std::unordered_map<fw::ID, Timepoint> m_batchSince;/** since when the partial request of each session is held back*/
+    uint64_t m_requestCnt{ 0 };/** data requests sent*/
+    uint64_t m_requestedPieceCnt{ 0 };/** pieces in those requests*/
+    Timepoint m_timerTic{ Timepoint::Zero() };/** the deadline the schedule timer is armed for, zero if none*/
+
+    /// It's multipath scheduler's duty to maintain session_needdownloadsubpiece, and m_rttRanking
+    std::unordered_map<fw::ID, PieceSet> m_session_needdownloadpieceQ;// session task queues
+    SessionRanking m_rttRanking;/** the sessions by srtt, lowest first*/
+    std::vector<uint32_t> m_toSendCnt;/** pieces to hand each ranked session in FillUpSessionTask, by rank*/
     fw::weak_ptr<MultiPathSchedulerHandler> m_phandler;
 
 };
@@ -0,0 +1,154 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "basefw/base/hash.h"
+#include "idhash.hpp"
+#include "basefw/base/shared_ptr.h"
+#include "utils/transporttime.h"
+#include "sessionstreamcontroller.hpp"
+
+/** Sessions ranked by a score, the lowest first, kept in order as the scores change instead of sorted again for
+ *  every scheduling pass. Each ranked session has a handle that holds its position in the order, so a new score
+ *  moves it past the neighbours it overtakes, usually none or a few for an RTT sample, and walking the order only
+ *  reads a vector. A session is allocated a handle and its shared_ptr copied once, when it is ranked.
+ *  A session newly ranked goes behind those of equal score.
+ * */
+class SessionRanking
+{
+public:
+    /// a ranked session
+    struct Ranked
+    {
+        fw::ID sessionid;
+        fw::shared_ptr<SessionStreamController> session;
+        Duration score{ Duration::Zero() };
+        size_t pos{ 0 };/** index in the order*/
+    };
+
+    using const_iterator = std::vector<Ranked*>::const_iterator;
+
+    /// rank session, or give it a new score if it is ranked already
+    void Insert(const fw::ID& sessionid, const fw::shared_ptr<SessionStreamController>& session, Duration score)
+    {
+        auto&& itor = m_handles.find(sessionid);
+        if (itor != m_handles.end())
+        {
+            itor->second->session = session;
+            Update(*itor->second, score);
+            return;
+        }
+        std::unique_ptr<Ranked> ranked(new Ranked);
+        ranked->sessionid = sessionid;
+        ranked->session = session;
+        ranked->score = score;
+        ranked->pos = m_order.size();
+        m_order.push_back(ranked.get());
+        Ranked& handle = *ranked;
+        m_handles.emplace(sessionid, std::move(ranked));
+        MoveUp(handle);
+    }
+
+    /// @return false if sessionid isn't ranked
+    bool Erase(const fw::ID& sessionid)
+    {
+        auto&& itor = m_handles.find(sessionid);
+        if (itor == m_handles.end())
+        {
+            return false;
+        }
+        // the ones behind it move up a place, their order holds
+        for (size_t pos = itor->second->pos; pos + 1 < m_order.size(); ++pos)
+        {
+            m_order[pos] = m_order[pos + 1];
+            m_order[pos]->pos = pos;
+        }
+        m_order.pop_back();
+        m_handles.erase(itor);
+        return true;
+    }
+
+    /// the handle of sessionid, nullptr if it isn't ranked
+    Ranked* Find(const fw::ID& sessionid)
+    {
+        auto&& itor = m_handles.find(sessionid);
+        return itor == m_handles.end() ? nullptr : itor->second.get();
+    }
+
+    /// move ranked to its place for score, nothing moves if the score is unchanged
+    void Update(Ranked& ranked, Duration score)
+    {
+        if (score == ranked.score)
+        {
+            return;
+        }
+        bool lower = score < ranked.score;
+        ranked.score = score;
+        if (lower)
+        {
+            MoveUp(ranked);
+        }
+        else
+        {
+            MoveDown(ranked);
+        }
+    }
+
+    void Clear()
+    {
+        m_order.clear();
+        m_handles.clear();
+    }
+
+    size_t size() const
+    {
+        return m_order.size();
+    }
+
+    bool empty() const
+    {
+        return m_order.empty();
+    }
+
+    /// the sessions in ascending score
+    const_iterator begin() const
+    {
+        return m_order.begin();
+    }
+
+    const_iterator end() const
+    {
+        return m_order.end();
+    }
+
+private:
+    void Swap(size_t lhs, size_t rhs)
+    {
+        std::swap(m_order[lhs], m_order[rhs]);
+        m_order[lhs]->pos = lhs;
+        m_order[rhs]->pos = rhs;
+    }
+
+    void MoveUp(Ranked& ranked)
+    {
+        while (ranked.pos > 0 && ranked.score < m_order[ranked.pos - 1]->score)
+        {
+            Swap(ranked.pos - 1, ranked.pos);
+        }
+    }
+
+    void MoveDown(Ranked& ranked)
+    {
+        while (ranked.pos + 1 < m_order.size() && m_order[ranked.pos + 1]->score < ranked.score)
+        {
+            Swap(ranked.pos, ranked.pos + 1);
+        }
+    }
+
+    std::unordered_map<fw::ID, std::unique_ptr<Ranked>> m_handles;/** the handles of the ranked sessions*/
+    std::vector<Ranked*> m_order;/** ascending score*/
+};
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <cmath>
 #include <deque>
 #include <memory>
 #include "congestioncontrol.hpp"
@@ -13,43 +14,134 @@ class SessionStreamCtlHandler
 public:
     virtual void OnPiecePktTimeout(const basefw::ID& peerid, const std::vector<int32_t>& spns) = 0;
 
+    /// a piece reported lost by OnPiecePktTimeout has been received after all, no need to retransmit it
+    virtual void OnPiecePktSpuriousLoss(const basefw::ID& peerid, int32_t spn) = 0;
+
+    /// a new RTT sample of session peerid, taken from a piece received at recvtic
+    virtual void OnRttSample(const basefw::ID& peerid, Duration rtt, Timepoint recvtic) = 0;
+
     virtual bool DoSendDataRequest(const basefw::ID& peerid, const std::vector<int32_t>& spns) = 0;
+
+    /// arm a timer that fires at deadline for the packet seq on session peerid, return the timer id
+    virtual uint64_t ArmLossTimer(const basefw::ID& peerid, SeqNumber seq, Timepoint deadline) = 0;
+
+    virtual void CancelLossTimer(uint64_t timerid) = 0;
+};
+
+/// config of TokenBucketPacer
+struct PacerConfig
+{
+    uint32_t burst{ 8 };/** bucket depth, pieces that may be requested back to back*/
+    double pacingGain{ 1.25 };/** pace at gain * cwnd / srtt if the cc algo gives no pacing rate*/
+};
+
+/// config of the window cap of a session, which bounds the cc window by what the path can hold
+struct WindowCapConfig
+{
+    uint32_t initWnd{ 64 };/** cap before the session has both a bandwidth and a min RTT sample*/
+    uint32_t minWnd{ 8 };/** the cap never goes below, a full data request*/
+    double bdpGain{ 2.0 };/** cap at gain * max bandwidth * min RTT, room for the window to grow into*/
+};
+
+/// deferral statistics of TokenBucketPacer
+struct PacerStats
+{
+    uint64_t sentCnt{ 0 };/** pieces requested*/
+    uint64_t deferredCnt{ 0 };/** sends that had to wait for tokens while the window was open*/
+    Duration totalDeferral{ Duration::Zero() };
+    Duration maxDeferral{ Duration::Zero() };
+    Duration lastDeferral{ Duration::Zero() };
 };
 
-/// PacketSender is a simple traffic control module, in TCP or Quic, it is called Pacer.
-/// Decide if we can send pkt at this time
-class PacketSender
+/// TokenBucketPacer is the traffic control module, in TCP or Quic, it is called Pacer.
+/// Decide if we can send pkt at this time: the congestion window must be open and the bucket, refilled at the
+/// pacing rate, must hold a token for each requested piece. So the replies come back spread over the RTT instead
+/// of in one burst each time an ack opens the window.
+class TokenBucketPacer
 {
 public:
-    bool CanSend(uint32_t cwnd, uint32_t downloadingPktCnt)
+    explicit TokenBucketPacer(const PacerConfig& config)
+            : m_burst(std::max(1U, config.burst)), m_tokens(m_burst)
+    {
+    }
+
+    bool CanSend(uint32_t cwnd, uint32_t downloadingPktCnt, double pacingRate, Timepoint now)
     {
+        return MaySendPktCnt(cwnd, downloadingPktCnt, pacingRate, now) > 0;
+    }
 
-        auto rt = false;
-        if (cwnd > downloadingPktCnt)
+    uint32_t MaySendPktCnt(uint32_t cwnd, uint32_t downloadingPktCnt, double pacingRate, Timepoint now)
+    {
+        SPDLOG_TRACE("cwnd:{},downloadingPktCnt:{},pacingRate:{}", cwnd, downloadingPktCnt, pacingRate);
+        if (cwnd <= downloadingPktCnt)
         {
-            rt = true;
+            return 0U;
         }
-        else
+        Refill(pacingRate, now);
+        auto cnt = std::min(cwnd - downloadingPktCnt, static_cast<uint32_t>(m_tokens));
+        if (cnt == 0 && !m_deferStart.IsInitialized())
         {
-            rt = false;
+            // the window is open but the bucket is empty
+            m_deferStart = now;
         }
-        SPDLOG_TRACE("cwnd:{},downloadingPktCnt:{},rt: {}", cwnd, downloadingPktCnt, rt);
-        return rt;
+        return cnt;
     }
 
-    uint32_t MaySendPktCnt(uint32_t cwnd, uint32_t downloadingPktCnt)
+    /// the earliest time that a piece may be requested, Infinite if the window is full
+    Timepoint NextSendTime(uint32_t cwnd, uint32_t downloadingPktCnt, double pacingRate, Timepoint now)
     {
-        SPDLOG_TRACE("cwnd:{},downloadingPktCnt:{}", cwnd, downloadingPktCnt);
-        if (cwnd >= downloadingPktCnt)
+        if (cwnd <= downloadingPktCnt)
         {
-            return std::min(cwnd - downloadingPktCnt, 8U);
+            return Timepoint::Infinite();
         }
-        else
+        Refill(pacingRate, now);
+        if (m_tokens >= 1.0 || pacingRate <= 0)
         {
-            return 0U;
+            return now;
+        }
+        return now + Duration::FromMicroseconds(static_cast<int64_t>(std::ceil((1.0 - m_tokens) * 1000000.0 / pacingRate)));
+    }
+
+    void OnPacketSent(uint32_t pktCnt, Timepoint now)
+    {
+        m_tokens = std::max(0.0, m_tokens - pktCnt);
+        m_stats.sentCnt += pktCnt;
+        if (m_deferStart.IsInitialized())
+        {
+            Duration deferral = now - m_deferStart;
+            ++m_stats.deferredCnt;
+            m_stats.totalDeferral = m_stats.totalDeferral + deferral;
+            m_stats.maxDeferral = std::max(m_stats.maxDeferral, deferral);
+            m_stats.lastDeferral = deferral;
+            m_deferStart = Timepoint::Zero();
+        }
+    }
+
+    const PacerStats& GetStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    void Refill(double pacingRate, Timepoint now)
+    {
+        if (pacingRate <= 0)
+        {
+            // not paced, only the burst limits a single request
+            m_tokens = m_burst;
         }
+        else if (m_lastRefill.IsInitialized() && now > m_lastRefill)
+        {
+            m_tokens = std::min<double>(m_burst, m_tokens + pacingRate * (now - m_lastRefill).ToMicroseconds() / 1000000.0);
+        }
+        m_lastRefill = std::max(m_lastRefill, now);
     }
 
+    uint32_t m_burst;
+    double m_tokens;/** pieces, fractional between refills*/
+    Timepoint m_lastRefill{ Timepoint::Zero() };
+    Timepoint m_deferStart{ Timepoint::Zero() };/** since when a send has been held back by the bucket*/
+    PacerStats m_stats;
 };
 
 /// SessionStreamController is the single session delegate inside transport module.
@@ -70,7 +162,8 @@ public:
         StopSessionStreamCtl();
     }
 
-    void StartSessionStreamCtl(const basefw::ID& sessionId, RenoCongestionCtlConfig& ccConfig,
+    void StartSessionStreamCtl(const basefw::ID& sessionId, const CongestionCtlConfig& ccConfig,
+            const PacerConfig& pacerConfig, const WindowCapConfig& wndCapConfig,
             std::weak_ptr<SessionStreamCtlHandler> ssStreamHandler)
     {
         if (isRunning)
@@ -83,14 +176,24 @@ public:
         m_ssStreamHandler = ssStreamHandler;
         // cc
         m_ccConfig = ccConfig;
-        //m_congestionCtl.reset(new RenoCongestionContrl(m_ccConfig));
-        m_congestionCtl.reset(new TestCongestionCtrl(m_ccConfig));
+        m_congestionCtl = CongestionCtlFactory::Instance().Create(m_ccConfig);
+        if (!m_congestionCtl)
+        {
+            SPDLOG_WARN("session {} falls back to reno", m_sessionId.ToLogStr());
+            m_ccConfig.type = CongestionCtlType::reno;
+            m_congestionCtl = CongestionCtlFactory::Instance().Create(m_ccConfig);
+        }
+        m_congestionCtl->SetDeliveryRateSampler(&m_rateSampler);
+        SPDLOG_DEBUG("session {} cc config: {}", m_sessionId.ToLogStr(), m_ccConfig.DebugInfo());
 
         // send control
-        m_sendCtl.reset(new PacketSender());
+        m_pacerConfig = pacerConfig;
+        m_sendCtl.reset(new TokenBucketPacer(m_pacerConfig));
+        m_wndCapConfig = wndCapConfig;
 
         //loss detection
-        m_lossDetect.reset(new DefaultLossDetectionAlgo());
+        //m_lossDetect.reset(new DefaultLossDetectionAlgo());
+        m_lossDetect.reset(new PacketThresholdLossDetectionAlgo());
 
         // set initial smothed rtt
         m_rttstats.set_initial_rtt(Duration::FromMilliseconds(200));
@@ -102,6 +205,16 @@ public:
         if (isRunning)
         {
             isRunning = false;
+            CancelAllLossTimers();
+            m_recentlyLost.Clear();
+            SPDLOG_DEBUG("session {} spurious losses: {}", m_sessionId.ToLogStr(), m_spuriousLossCnt);
+            if (m_sendCtl)
+            {
+                SPDLOG_DEBUG("session {} paced pieces: {}, deferred sends: {}, total deferral: {}, max deferral: {}",
+                        m_sessionId.ToLogStr(), m_sendCtl->GetStats().sentCnt, m_sendCtl->GetStats().deferredCnt,
+                        m_sendCtl->GetStats().totalDeferral.ToDebuggingValue(),
+                        m_sendCtl->GetStats().maxDeferral.ToDebuggingValue());
+            }
         }
         else
         {
@@ -129,7 +242,8 @@ public:
             return false;
         }
 
-        return m_sendCtl->CanSend(m_congestionCtl->GetCWND(), GetInFlightPktNum());
+        return m_sendCtl->CanSend(GetWindow(), GetInFlightPktNum(), GetPacingRate(),
+                Clock::GetClock()->Now());
     }
 
     uint32_t CanRequestPktCnt()
@@ -139,9 +253,117 @@ public:
         {
             return false;
         }
-        return m_sendCtl->MaySendPktCnt(m_congestionCtl->GetCWND(), GetInFlightPktNum());
+        return m_sendCtl->MaySendPktCnt(GetWindow(), GetInFlightPktNum(), GetPacingRate(),
+                Clock::GetClock()->Now());
     };
 
+    /// the earliest time that this session may request a piece, Infinite if its window is full
+    Timepoint NextSendTime()
+    {
+        if (!isRunning)
+        {
+            return Timepoint::Infinite();
+        }
+        return m_sendCtl->NextSendTime(GetWindow(), GetInFlightPktNum(), GetPacingRate(),
+                Clock::GetClock()->Now());
+    }
+
+    /// pieces per second, the rate of the cc algo or gain * cwnd / srtt
+    double GetPacingRate()
+    {
+        double rate = m_congestionCtl->GetPacingRate();
+        if (rate > 0)
+        {
+            return rate;
+        }
+        return m_pacerConfig.pacingGain * GetWindowRate();
+    }
+
+    /// pieces per second the window allows, window / srtt
+    double GetWindowRate()
+    {
+        Duration srtt = m_rttstats.SmoothedOrInitialRtt();
+        if (srtt <= Duration::Zero())
+        {
+            return 0;
+        }
+        return GetWindow() * 1000000.0 / srtt.ToMicroseconds();
+    }
+
+    /// pieces this session may have in flight: the cc window, within the window cap and the budget share
+    uint32_t GetWindow()
+    {
+        if (!isRunning)
+        {
+            return 0;
+        }
+        return std::min(m_congestionCtl->GetCWND(), std::min(GetWindowCap(), m_wndBudget));
+    }
+
+    /** The window the path can hold, gain * max bandwidth * min RTT, so a session on a long fat path isn't held
+     *  to a fixed window while one on a short path doesn't fill the bottleneck queue with requests.
+     *  The max bandwidth is measured with the window so capped, the gain lets the cap grow as it does.
+     *  The min RTT is that of the whole session: a capped window keeps (gain - 1) * BDP queued, the windowed min
+     *  RTT would take in that queue once the path's own RTT ages out of it and the cap would grow by gain each time.
+     * */
+    uint32_t GetWindowCap()
+    {
+        double bw = GetMaxBandwidth();
+        Duration minRtt = isRunning ? m_rttstats.min_rtt() : Duration::Zero();
+        if (bw <= 0 || minRtt <= Duration::Zero() || minRtt.IsInfinite())
+        {
+            return std::max(m_wndCapConfig.minWnd, m_wndCapConfig.initWnd);
+        }
+        double bdp = std::ceil(m_wndCapConfig.bdpGain * bw * minRtt.ToMicroseconds() / 1000000.0);
+        if (bdp >= UINT32_MAX)
+        {
+            return UINT32_MAX;
+        }
+        return std::max(m_wndCapConfig.minWnd, static_cast<uint32_t>(bdp));
+    }
+
+    /// the share of the task window budget this session is given, pieces
+    void SetWindowBudget(uint32_t budget)
+    {
+        m_wndBudget = std::max(m_wndCapConfig.minWnd, budget);
+    }
+
+    const PacerStats& GetPacerStats() const
+    {
+        return m_sendCtl->GetStats();
+    }
+
+    /// delivery rate samples of this session, for cc algos and schedulers alike
+    const DeliveryRateSampler& GetDeliveryRateSampler() const
+    {
+        return m_rateSampler;
+    }
+
+    /// pieces per second delivered lately, 0 before the first sample spanning a round trip
+    double GetDeliveryRate() const
+    {
+        return m_rateSampler.GetDeliveryRate();
+    }
+
+    /// the scheduler had no piece to request while this session could send, the rate samples taken until
+    /// the requests in flight are delivered don't show what the path can do
+    void OnAppLimited()
+    {
+        if (isRunning)
+        {
+            m_rateSampler.OnAppLimited();
+        }
+    }
+
+    /// couple the congestion control of this session with the other sessions of group
+    void SetCoupledGroup(std::shared_ptr<CoupledCongestionCtlGroup> group)
+    {
+        if (m_congestionCtl)
+        {
+            m_congestionCtl->SetCoupledGroup(std::move(group));
+        }
+    }
+
     /// send ONE datarequest Pkt, requestting for the data pieces whose id are in spns
     bool DoRequestdata(const basefw::ID& peerid, const std::vector<int32_t>& spns)
     {
@@ -164,7 +386,12 @@ public:
         auto handler = m_ssStreamHandler.lock();
         if (handler)
         {
-            return handler->DoSendDataRequest(peerid, spns);
+            bool rt = handler->DoSendDataRequest(peerid, spns);
+            if (rt)
+            {
+                m_sendCtl->OnPacketSent(spns.size(), Clock::GetClock()->Now());
+            }
+            return rt;
         }
         else
         {
@@ -185,6 +412,7 @@ public:
             return;
         }
         auto seqidx = 0;
+        Duration lossDelay = m_lossDetect->GetLossDelay(m_rttstats);
         for (auto datano: dataids)
         {
             DataPacket p;
@@ -192,6 +420,8 @@ public:
             p.pieceId = datano;
             // add to downloading queue
             m_inflightpktmap.AddSentPacket(p, sendtic);
+            ArmLossTimer(p.seq, sendtic, lossDelay);
+            m_rateSampler.OnPacketSent(p.seq, sendtic);
 
             // inform cc algo that a packet is sent
             InflightPacket sentpkt;
@@ -223,6 +453,11 @@ public:
             auto pkt_rtt = recvtic - inflightPkt.sendtic;
             m_rttstats.UpdateRtt(pkt_rtt, Duration::Zero(), Clock::GetClock()->Now());
             //auto newsrtt = m_rttstats.smoothed_rtt();
+            auto handler = m_ssStreamHandler.lock();
+            if (handler)
+            {
+                handler->OnRttSample(m_sessionId, pkt_rtt, recvtic);
+            }
 
             //auto oldcwnd = m_congestionCtl->GetCWND();
 
@@ -231,14 +466,33 @@ public:
             ackEvent.ackPacket.seq = seq;
             ackEvent.ackPacket.pieceId = datapiece;
             ackEvent.sendtic = inflightPkt.sendtic;
-            LossEvent lossEvent; // if we detect loss when ACK event, we may do loss check here.
-            m_congestionCtl->OnDataAckOrLoss(ackEvent, lossEvent, m_rttstats);
 
-            //auto newcwnd = m_congestionCtl->GetCWND();
             // mark as received
             m_inflightpktmap.OnPacktReceived(inflightPkt, recvtic);
+            CancelLossTimer(seq);
+            if (m_rateSampler.OnPacketAcked(seq, Clock::GetClock()->Now(), m_rttstats.windowed_min_rtt()))
+            {
+                const RateSample& sample = m_rateSampler.LatestSample();
+                if (!sample.appLimited || sample.deliveryRate > m_rttstats.windowed_max_bandwidth())
+                {
+                    m_rttstats.UpdateMaxBandwidth(sample.deliveryRate, m_rateSampler.GetRoundCnt());
+                }
+            }
+
+            // an ack may reveal losses of earlier packets
+            LossEvent lossEvent;
+            m_lossDetect->DetectLoss(m_inflightpktmap, Clock::GetClock()->Now(), ackEvent,
+                    m_inflightpktmap.MaxSeqAckedPkt().seq, lossEvent, m_rttstats);
+            RemoveLostFromInFlight(lossEvent);
+            m_congestionCtl->OnDataAckOrLoss(ackEvent, lossEvent, m_rttstats);
+
+            //auto newcwnd = m_congestionCtl->GetCWND();
+            if (lossEvent.valid)
+            {
+                InformLossUp(lossEvent);
+            }
         }
-        else
+        else if (!OnLateArrival(seq, datapiece, recvtic))
         {
             SPDLOG_WARN(" Recv an pkt with unknown seq:{}", seq);
         }
@@ -250,6 +504,31 @@ public:
         DoAlarmTimeoutDetection();
     }
 
+    /// loss timers of packets in seqs have fired, check loss and re-arm the packets still in flight
+    void OnLossTimerExpired(const std::vector<SeqNumber>& seqs)
+    {
+        if (!isRunning)
+        {
+            return;
+        }
+        for (auto seq: seqs)
+        {
+            // these timers have been consumed by the wheel
+            m_lossTimers.Erase(seq);
+        }
+        DoAlarmTimeoutDetection();
+        // the loss delay may have grown since the packet was sent
+        Duration lossDelay = m_lossDetect->GetLossDelay(m_rttstats);
+        for (auto seq: seqs)
+        {
+            auto rtpair = m_inflightpktmap.PktIsInFlight(seq);
+            if (rtpair.first)
+            {
+                ArmLossTimer(seq, rtpair.second.sendtic, lossDelay);
+            }
+        }
+    }
+
     void InformLossUp(LossEvent& loss)
     {
         if (!isRunning)
@@ -278,13 +557,11 @@ public:
         Timepoint now_t = Clock::GetClock()->Now();
         AckEvent ack;
         LossEvent loss;
-        m_lossDetect->DetectLoss(m_inflightpktmap, now_t, ack, -1, loss, m_rttstats);
+        m_lossDetect->DetectLoss(m_inflightpktmap, now_t, ack, m_inflightpktmap.MaxSeqAckedPkt().seq, loss,
+                m_rttstats);
         if (loss.valid)
         {
-            for (auto&& pkt: loss.lossPackets)
-            {
-                m_inflightpktmap.RemoveFromInFlight(pkt);
-            }
+            RemoveLostFromInFlight(loss);
             m_congestionCtl->OnDataAckOrLoss(ack, loss, m_rttstats);
             InformLossUp(loss);
         }
@@ -301,6 +578,24 @@ public:
         return rtt;
     }
 
+    /// the smoothed RTT, or the initial RTT before the first sample
+    Duration GetSmoothedOrInitialRtt()
+    {
+        return m_rttstats.SmoothedOrInitialRtt();
+    }
+
+    /// min RTT over the last 10 seconds, the propagation delay as far as we can tell
+    Duration GetMinRtt()
+    {
+        return isRunning ? m_rttstats.windowed_min_rtt() : Duration::Zero();
+    }
+
+    /// max delivery rate over the last 10 round trips, pieces per second
+    double GetMaxBandwidth()
+    {
+        return isRunning ? m_rttstats.windowed_max_bandwidth() : 0;
+    }
+
     uint32_t GetInFlightPktNum()
     {
         return m_inflightpktmap.InFlightPktNum();
@@ -312,18 +607,131 @@ public:
         return m_sessionId;
     }
 
+    /// how many packets declared lost have been received later
+    uint64_t GetSpuriousLossCnt() const
+    {
+        return m_spuriousLossCnt;
+    }
+
 private:
+    void RemoveLostFromInFlight(LossEvent& loss)
+    {
+        for (auto&& pkt: loss.lossPackets)
+        {
+            m_inflightpktmap.RemoveFromInFlight(pkt);
+            CancelLossTimer(pkt.seq);
+            m_rateSampler.OnPacketLost(pkt.seq);
+            RememberLost(pkt);
+        }
+    }
+
+    /// keep the lost packet for a while, so a late arrival can still be matched
+    void RememberLost(const InflightPacket& pkt)
+    {
+        if (!m_recentlyLost.Insert(pkt.seq, pkt))
+        {
+            return;
+        }
+        // bound both the count and the seq span, the ring allocates for the whole span. The oldest go first, but
+        // not pkt: a loss declared out of order may be older than all the others, it is kept over the count then
+        // and the next newer loss evicts it
+        while (!m_recentlyLost.empty() && m_recentlyLost.BaseSeq() < pkt.seq &&
+               (m_recentlyLost.size() > kMaxRecentlyLost || pkt.seq - m_recentlyLost.BaseSeq() >= kMaxRecentlyLostSpan))
+        {
+            m_recentlyLost.Erase(m_recentlyLost.BaseSeq());
+        }
+    }
+
+    /// @return true if seq is a packet declared lost before, whose loss is undone now
+    bool OnLateArrival(SeqNumber seq, int32_t datapiece, Timepoint recvtic)
+    {
+        const auto* lostpkt = m_recentlyLost.Find(seq);
+        if (!lostpkt || lostpkt->pieceId != datapiece)
+        {
+            return false;
+        }
+        InflightPacket pkt = *lostpkt;
+        m_recentlyLost.Erase(seq);
+        ++m_spuriousLossCnt;
+        SPDLOG_DEBUG("spurious loss seq:{}, piece:{}, cnt:{}", seq, datapiece, m_spuriousLossCnt);
+        DEMO_TRACE_LOSS(TraceEvent::pktSpurious, seq, datapiece, recvtic.ToDebuggingValue(),
+                pkt.sendtic.ToDebuggingValue(), m_congestionCtl->GetCWND(), GetInFlightPktNum());
+
+        // adapt the loss thresholds before this sample gets into the RTT stats
+        m_lossDetect->OnSpuriousLoss(pkt, recvtic, m_inflightpktmap.MaxSeqAckedPkt().seq, m_rttstats);
+        m_rttstats.UpdateRtt(recvtic - pkt.sendtic, Duration::Zero(), Clock::GetClock()->Now());
+        m_congestionCtl->OnSpuriousLoss(pkt);
+
+        auto handler = m_ssStreamHandler.lock();
+        if (handler)
+        {
+            handler->OnPiecePktSpuriousLoss(m_sessionId, datapiece);
+        }
+        return true;
+    }
+
+    void ArmLossTimer(SeqNumber seq, Timepoint sendtic, Duration lossDelay)
+    {
+        if (lossDelay.IsInfinite())
+        {
+            // the loss detection algo doesn't use a time threshold
+            return;
+        }
+        auto handler = m_ssStreamHandler.lock();
+        if (handler)
+        {
+            m_lossTimers.Insert(seq, handler->ArmLossTimer(m_sessionId, seq, sendtic + lossDelay));
+        }
+    }
+
+    void CancelLossTimer(SeqNumber seq)
+    {
+        const auto* timerid = m_lossTimers.Find(seq);
+        if (!timerid)
+        {
+            return;
+        }
+        auto handler = m_ssStreamHandler.lock();
+        if (handler)
+        {
+            handler->CancelLossTimer(*timerid);
+        }
+        m_lossTimers.Erase(seq);
+    }
+
+    void CancelAllLossTimers()
+    {
+        auto handler = m_ssStreamHandler.lock();
+        if (handler)
+        {
+            for (const auto& seq_timer: m_lossTimers)
+            {
+                handler->CancelLossTimer(seq_timer.second);
+            }
+        }
+        m_lossTimers.Clear();
+    }
+
     bool isRunning{ false };
 
     basefw::ID m_sessionId;/** The remote peer id defines the session id*/
     basefw::ID m_taskid;/**The file id downloading*/
-    RenoCongestionCtlConfig m_ccConfig;
+    CongestionCtlConfig m_ccConfig;
+    DeliveryRateSampler m_rateSampler;/** declared before the cc algo, which keeps a pointer to it*/
     std::unique_ptr<CongestionCtlAlgo> m_congestionCtl;
     std::unique_ptr<LossDetectionAlgo> m_lossDetect;
     std::weak_ptr<SessionStreamCtlHandler> m_ssStreamHandler;
     InFlightPacketMap m_inflightpktmap;
-
-    std::unique_ptr<PacketSender> m_sendCtl;
+    SeqIndexedRing<uint64_t> m_lossTimers;/** loss timer id of each packet in flight*/
+    SeqIndexedRing<InflightPacket> m_recentlyLost;/** packets declared lost lately, oldest evicted first*/
+    uint64_t m_spuriousLossCnt{ 0 };
+    static constexpr size_t kMaxRecentlyLost = 256;
+    static constexpr SeqNumber kMaxRecentlyLostSpan = 4096;
+
+    PacerConfig m_pacerConfig;
+    std::unique_ptr<TokenBucketPacer> m_sendCtl;
+    WindowCapConfig m_wndCapConfig;
+    uint32_t m_wndBudget{ UINT32_MAX };/** no budget until the transport controller shares one out*/
     RttStats m_rttstats;
 };
 
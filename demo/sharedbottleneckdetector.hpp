@@ -0,0 +1,331 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "basefw/base/log.h"
+#include "idhash.hpp"
+#include "utils/transporttime.h"
+#include "utils/defaultclock.hpp"
+
+/// tunables of SharedBottleneckDetector, the defaults are the values suggested by RFC 8382 Section 3.1
+struct SharedBottleneckConfig
+{
+    uint32_t intervalMs{ 350 };/** T, the base time interval the samples are summarized over*/
+    uint32_t longWindow{ 50 };/** N, intervals the skew, variability, frequency and loss estimates span*/
+    uint32_t meanWindow{ 30 };/** M, intervals the mean delay spans*/
+    uint32_t minIntervals{ 10 };/** a session is grouped once it has samples in this many intervals*/
+    double skewThresh{ -0.01 };/** c_s, a session is behind a bottleneck if its skew_est is below this*/
+    double skewHysteresis{ 0.3 };/** c_h, and stays behind it until skew_est rises above this*/
+    double lossThresh{ 0.1 };/** p_l, a session losing more than this is behind a bottleneck*/
+    double freqGroupThresh{ 0.1 };/** p_f*/
+    double varGroupThresh{ 0.1 };/** p_mad*/
+    double skewGroupThresh{ 0.15 };/** p_s*/
+    double lossGroupThresh{ 0.1 };/** p_d*/
+    double freqSignificance{ 0.7 };/** p_v, a mean delay crossing counts if it is this many var_est away*/
+};
+
+/** Shared bottleneck detection after RFC 8382.
+ *  Every session feeds its delay samples and losses. At the end of each base interval the summary statistics of
+ *  each session are updated over the sliding windows: skew_est, the share of samples below rather than above the
+ *  mean delay; var_est, the mean absolute deviation from it; freq_est, how often the interval mean swings across
+ *  it; and the loss rate. Sessions behind a bottleneck are then split into groups by freq_est, var_est, skew_est
+ *  and the loss rate, sessions whose statistics are too far apart can't share the same bottleneck.
+ *  We only have RTT samples, the request direction carries small packets so the delay variation is dominated by
+ *  the data direction, like the OWD the RFC assumes.
+ * */
+class SharedBottleneckDetector
+{
+public:
+    using SessionGroups = std::vector<std::vector<basefw::ID>>;
+
+    explicit SharedBottleneckDetector(const SharedBottleneckConfig& config = SharedBottleneckConfig())
+            : m_config(config)
+    {
+    }
+
+    void OnDelaySample(const basefw::ID& sessionid, Duration delay, Timepoint now)
+    {
+        auto& flow = m_flows[sessionid];
+        double delayMs = delay.ToMicroseconds() / 1000.0;
+        auto& curr = flow.curr;
+        ++curr.sampleCnt;
+        curr.delaySum += delayMs;
+        if (flow.hasMean)
+        {
+            // compared with the mean delay of the earlier intervals
+            ++curr.skewCnt;
+            curr.skewSum += delayMs < flow.meanDelay ? 1 : (delayMs > flow.meanDelay ? -1 : 0);
+            curr.varSum += std::fabs(delayMs - flow.meanDelay);
+        }
+    }
+
+    void OnLoss(const basefw::ID& sessionid, uint32_t lostCnt)
+    {
+        m_flows[sessionid].curr.lostCnt += lostCnt;
+    }
+
+    /// @return true if the groups have changed
+    bool RemoveSession(const basefw::ID& sessionid)
+    {
+        return m_flows.erase(sessionid) > 0 && Regroup();
+    }
+
+    /// close the base intervals that have ended by now and regroup, @return true if the groups have changed
+    bool OnTimeElapsed(Timepoint now)
+    {
+        Duration interval = Duration::FromMilliseconds(m_config.intervalMs);
+        if (!m_intervalStart.IsInitialized())
+        {
+            m_intervalStart = now;
+            return false;
+        }
+        if (now < m_intervalStart + interval)
+        {
+            return false;
+        }
+        // intervals passed without any packet are skipped, they carry no sample
+        m_intervalStart = m_intervalStart +
+                interval * static_cast<int>((now - m_intervalStart).ToMicroseconds() / interval.ToMicroseconds());
+        for (auto&& id_flow: m_flows)
+        {
+            CloseInterval(id_flow.second);
+        }
+        return Regroup();
+    }
+
+    /// a partition of the grouped sessions, the sessions of a group share a bottleneck, the sessions not behind
+    /// a bottleneck are alone in their group. Sessions with too few samples yet are in no group.
+    const SessionGroups& GetGroups() const
+    {
+        return m_groups;
+    }
+
+private:
+    /// per session summary of one base interval
+    struct IntervalSummary
+    {
+        uint32_t sampleCnt{ 0 };
+        double delaySum{ 0 };
+        uint32_t skewCnt{ 0 };/** samples taken when a mean delay was known*/
+        int32_t skewSum{ 0 };
+        double varSum{ 0 };
+        uint32_t lostCnt{ 0 };
+        bool crossed{ false };/** the interval mean crossed the mean delay significantly*/
+    };
+
+    struct FlowState
+    {
+        IntervalSummary curr;
+        std::deque<IntervalSummary> history;/** the last longWindow intervals with samples, newest at the back*/
+        bool hasMean{ false };
+        double meanDelay{ 0 };/** ms*/
+        int32_t lastSide{ 0 };/** 1 if the interval mean was last significantly above the mean delay, -1 below*/
+        double skewEst{ 0 };
+        double varEst{ 0 };/** ms*/
+        double freqEst{ 0 };
+        double lossRate{ 0 };
+        bool bottlenecked{ false };
+    };
+
+    struct FlowRef
+    {
+        basefw::ID id;
+        const FlowState* flow;
+    };
+
+    void CloseInterval(FlowState& flow)
+    {
+        IntervalSummary curr = flow.curr;
+        flow.curr = IntervalSummary();
+        if (curr.sampleCnt == 0)
+        {
+            if (curr.lostCnt > 0 && !flow.history.empty())
+            {
+                flow.history.back().lostCnt += curr.lostCnt;
+            }
+            return;
+        }
+        if (flow.hasMean)
+        {
+            double intervalMean = curr.delaySum / curr.sampleCnt;
+            double margin = m_config.freqSignificance * flow.varEst;
+            int32_t side = intervalMean > flow.meanDelay + margin ? 1 :
+                           (intervalMean < flow.meanDelay - margin ? -1 : 0);
+            if (side != 0)
+            {
+                curr.crossed = flow.lastSide != 0 && side != flow.lastSide;
+                flow.lastSide = side;
+            }
+        }
+        flow.history.push_back(curr);
+        while (flow.history.size() > m_config.longWindow)
+        {
+            flow.history.pop_front();
+        }
+        UpdateEstimates(flow);
+    }
+
+    void UpdateEstimates(FlowState& flow)
+    {
+        uint64_t meanCnt = 0;
+        double meanSum = 0;
+        uint64_t sampleCnt = 0;
+        uint64_t skewCnt = 0;
+        int64_t skewSum = 0;
+        double varSum = 0;
+        uint64_t lostCnt = 0;
+        uint32_t crossings = 0;
+        uint32_t age = 0;
+        for (auto itor = flow.history.rbegin(); itor != flow.history.rend(); ++itor, ++age)
+        {
+            if (age < m_config.meanWindow)
+            {
+                meanCnt += itor->sampleCnt;
+                meanSum += itor->delaySum;
+            }
+            sampleCnt += itor->sampleCnt;
+            skewCnt += itor->skewCnt;
+            skewSum += itor->skewSum;
+            varSum += itor->varSum;
+            lostCnt += itor->lostCnt;
+            crossings += itor->crossed ? 1 : 0;
+        }
+        flow.hasMean = meanCnt > 0;
+        flow.meanDelay = flow.hasMean ? meanSum / meanCnt : 0;
+        flow.skewEst = skewCnt > 0 ? static_cast<double>(skewSum) / skewCnt : 0;
+        flow.varEst = skewCnt > 0 ? varSum / skewCnt : 0;
+        flow.freqEst = static_cast<double>(crossings) / flow.history.size();
+        flow.lossRate = static_cast<double>(lostCnt) / (lostCnt + sampleCnt);
+        // RFC 8382 Section 3.3.2 step 1, with hysteresis
+        flow.bottlenecked = flow.skewEst < m_config.skewThresh ||
+                            (flow.bottlenecked && flow.skewEst < m_config.skewHysteresis) ||
+                            flow.lossRate > m_config.lossThresh;
+    }
+
+    /// sort the groups by key and split them where neighbours differ by more than thresh, or by more than
+    /// thresh times the larger one if relative
+    template <typename Key>
+    static std::vector<std::vector<FlowRef>> Split(const std::vector<std::vector<FlowRef>>& groups, Key key,
+            double thresh, bool relative)
+    {
+        std::vector<std::vector<FlowRef>> result;
+        for (auto group: groups)
+        {
+            std::sort(group.begin(), group.end(), [&key](const FlowRef& lhs, const FlowRef& rhs)
+            {
+                return key(*lhs.flow) < key(*rhs.flow);
+            });
+            result.emplace_back();
+            for (size_t i = 0; i < group.size(); ++i)
+            {
+                if (i > 0)
+                {
+                    double prev = key(*group[i - 1].flow);
+                    double curr = key(*group[i].flow);
+                    double limit = relative ? thresh * std::max(std::fabs(prev), std::fabs(curr)) : thresh;
+                    if (curr - prev > limit)
+                    {
+                        result.emplace_back();
+                    }
+                }
+                result.back().push_back(group[i]);
+            }
+        }
+        return result;
+    }
+
+    bool Regroup()
+    {
+        std::vector<FlowRef> bottlenecked;
+        SessionGroups groups;
+        for (auto&& id_flow: m_flows)
+        {
+            if (id_flow.second.history.size() < m_config.minIntervals)
+            {
+                continue;
+            }
+            if (id_flow.second.bottlenecked)
+            {
+                bottlenecked.push_back(FlowRef{ id_flow.first, &id_flow.second });
+            }
+            else
+            {
+                groups.push_back({ id_flow.first });
+            }
+        }
+        // RFC 8382 Section 3.3.2 steps 2 to 5
+        std::vector<std::vector<FlowRef>> split{ bottlenecked };
+        split = Split(split, [](const FlowState& flow)
+        {
+            return flow.freqEst;
+        }, m_config.freqGroupThresh, false);
+        split = Split(split, [](const FlowState& flow)
+        {
+            return flow.varEst;
+        }, m_config.varGroupThresh, true);
+        split = Split(split, [](const FlowState& flow)
+        {
+            return flow.skewEst;
+        }, m_config.skewGroupThresh, false);
+        std::vector<std::vector<FlowRef>> lossy;
+        for (auto&& group: split)
+        {
+            bool allLossy = std::all_of(group.begin(), group.end(), [this](const FlowRef& ref)
+            {
+                return ref.flow->lossRate > m_config.lossThresh;
+            });
+            if (allLossy)
+            {
+                lossy.push_back(group);
+            }
+            else
+            {
+                AppendGroup(group, groups);
+            }
+        }
+        for (auto&& group: Split(lossy, [](const FlowState& flow)
+        {
+            return flow.lossRate;
+        }, m_config.lossGroupThresh, true))
+        {
+            AppendGroup(group, groups);
+        }
+
+        for (auto&& group: groups)
+        {
+            std::sort(group.begin(), group.end());
+        }
+        std::sort(groups.begin(), groups.end());
+        if (groups == m_groups)
+        {
+            return false;
+        }
+        m_groups.swap(groups);
+        SPDLOG_DEBUG("shared bottleneck groups changed, {} groups", m_groups.size());
+        return true;
+    }
+
+    static void AppendGroup(const std::vector<FlowRef>& group, SessionGroups& groups)
+    {
+        if (group.empty())
+        {
+            return;
+        }
+        groups.emplace_back();
+        for (auto&& ref: group)
+        {
+            groups.back().push_back(ref.id);
+        }
+    }
+
+    SharedBottleneckConfig m_config;
+    std::unordered_map<basefw::ID, FlowState> m_flows;
+    Timepoint m_intervalStart{ Timepoint::Zero() };
+    SessionGroups m_groups;
+};
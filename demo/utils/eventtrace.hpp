@@ -0,0 +1,177 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <ostream>
+#include <sstream>
+#include <vector>
+#include "basefw/base/log.h"
+
+/** Structured per-packet event tracing.
+ *  Events are fixed size binary records pushed into a preallocated ring; nothing is formatted until the ring is
+ *  dumped. Each category is compiled in only if its bit is set in DEMO_TRACE_CATEGORIES, otherwise its macro
+ *  expands to a dead branch: the arguments are still type checked but never evaluated.
+ *  All transport callbacks run on a single thread, so the ring is not synchronized.
+ * */
+#define DEMO_TRACE_CAT_INFLIGHT 0x1
+#define DEMO_TRACE_CAT_LOSS 0x2
+#define DEMO_TRACE_CAT_CC 0x4
+#define DEMO_TRACE_CAT_SCHED 0x8
+
+#ifndef DEMO_TRACE_CATEGORIES
+#define DEMO_TRACE_CATEGORIES 0
+#endif
+
+#ifndef DEMO_TRACE_RING_SIZE
+#define DEMO_TRACE_RING_SIZE (1U << 16)
+#endif
+
+enum class TraceEvent : uint8_t
+{
+    pktSent = 0,
+    pktAcked,
+    pktRemoved,
+    pktLost,
+    pktSpurious,
+    ccAck,
+    ccLoss,
+    schedRequest,
+};
+
+struct TraceRecord
+{
+    int64_t tic_us{ 0 };
+    int64_t sendtic_us{ 0 };
+    uint32_t seq{ 0 };
+    int32_t pieceId{ 0 };
+    uint32_t cwnd{ 0 };
+    uint32_t inflight{ 0 };
+    TraceEvent type{ TraceEvent::pktSent };
+};
+
+class EventTraceRing
+{
+public:
+    static EventTraceRing& Instance()
+    {
+        static EventTraceRing ring;
+        return ring;
+    }
+
+    void Push(TraceEvent type, uint32_t seq, int32_t pieceId, int64_t tic_us, int64_t sendtic_us,
+            uint32_t cwnd, uint32_t inflight)
+    {
+        auto& rec = m_records[m_next & (m_records.size() - 1)];
+        rec.type = type;
+        rec.seq = seq;
+        rec.pieceId = pieceId;
+        rec.tic_us = tic_us;
+        rec.sendtic_us = sendtic_us;
+        rec.cwnd = cwnd;
+        rec.inflight = inflight;
+        ++m_next;
+    }
+
+    /// format the records still in the ring, oldest first
+    void Dump(std::ostream& os) const
+    {
+        uint64_t cnt = std::min<uint64_t>(m_next, m_records.size());
+        for (uint64_t i = m_next - cnt; i < m_next; ++i)
+        {
+            const auto& rec = m_records[i & (m_records.size() - 1)];
+            os << "{ event: " << EventName(rec.type) << " seq: " << rec.seq << " pieceId: " << rec.pieceId
+               << " tic: " << rec.tic_us << " sendtic: " << rec.sendtic_us << " cwnd: " << rec.cwnd
+               << " inflight: " << rec.inflight << " }\n";
+        }
+    }
+
+    void DumpToLog() const
+    {
+        if (m_next == 0)
+        {
+            return;
+        }
+        std::stringstream ss;
+        Dump(ss);
+        SPDLOG_INFO("{} trace events, last {}:\n{}", m_next, std::min<uint64_t>(m_next, m_records.size()), ss.str());
+    }
+
+    uint64_t PushedCnt() const
+    {
+        return m_next;
+    }
+
+private:
+    EventTraceRing() : m_records(RoundUpPow2(DEMO_TRACE_RING_SIZE))
+    {
+    }
+
+    static size_t RoundUpPow2(size_t n)
+    {
+        size_t cap = 1;
+        while (cap < n)
+        {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    static const char* EventName(TraceEvent type)
+    {
+        switch (type)
+        {
+            case TraceEvent::pktSent:
+                return "pktSent";
+            case TraceEvent::pktAcked:
+                return "pktAcked";
+            case TraceEvent::pktRemoved:
+                return "pktRemoved";
+            case TraceEvent::pktLost:
+                return "pktLost";
+            case TraceEvent::pktSpurious:
+                return "pktSpurious";
+            case TraceEvent::ccAck:
+                return "ccAck";
+            case TraceEvent::ccLoss:
+                return "ccLoss";
+            case TraceEvent::schedRequest:
+                return "schedRequest";
+        }
+        return "unknown";
+    }
+
+    std::vector<TraceRecord> m_records;
+    uint64_t m_next{ 0 };/** total records pushed, the next slot is m_next % size*/
+};
+
+#if DEMO_TRACE_CATEGORIES & DEMO_TRACE_CAT_INFLIGHT
+#define DEMO_TRACE_INFLIGHT(...) EventTraceRing::Instance().Push(__VA_ARGS__)
+#else
+#define DEMO_TRACE_INFLIGHT(...) do { if (false) { EventTraceRing::Instance().Push(__VA_ARGS__); } } while (0)
+#endif
+
+#if DEMO_TRACE_CATEGORIES & DEMO_TRACE_CAT_LOSS
+#define DEMO_TRACE_LOSS(...) EventTraceRing::Instance().Push(__VA_ARGS__)
+#else
+#define DEMO_TRACE_LOSS(...) do { if (false) { EventTraceRing::Instance().Push(__VA_ARGS__); } } while (0)
+#endif
+
+#if DEMO_TRACE_CATEGORIES & DEMO_TRACE_CAT_CC
+#define DEMO_TRACE_CC(...) EventTraceRing::Instance().Push(__VA_ARGS__)
+#else
+#define DEMO_TRACE_CC(...) do { if (false) { EventTraceRing::Instance().Push(__VA_ARGS__); } } while (0)
+#endif
+
+#if DEMO_TRACE_CATEGORIES & DEMO_TRACE_CAT_SCHED
+#define DEMO_TRACE_SCHED(...) EventTraceRing::Instance().Push(__VA_ARGS__)
+#else
+#define DEMO_TRACE_SCHED(...) do { if (false) { EventTraceRing::Instance().Push(__VA_ARGS__); } } while (0)
+#endif
+
+#if DEMO_TRACE_CATEGORIES
+#define DEMO_TRACE_DUMP() EventTraceRing::Instance().DumpToLog()
+#else
+#define DEMO_TRACE_DUMP() do {} while (0)
+#endif
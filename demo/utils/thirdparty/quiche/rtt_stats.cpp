@@ -22,6 +22,8 @@ namespace quic
         const float kBeta = 0.25f;
         const float kOneMinusBeta = (1 - kBeta);
         const int64_t kInitialRttMs = 1000;
+        const int64_t kMinRttWindowMs = 10000;
+        const uint64_t kMaxBandwidthWindowRounds = 10;
 
     }  // namespace
 
@@ -33,7 +35,10 @@ namespace quic
               mean_deviation_(QuicTime::Delta::Zero()),
               calculate_standard_deviation_(false),
               initial_rtt_(QuicTime::Delta::FromMilliseconds(kInitialRttMs)),
-              last_update_time_(QuicTime::Zero())
+              last_update_time_(QuicTime::Zero()),
+              windowed_min_rtt_(QuicTime::Delta::FromMilliseconds(kMinRttWindowMs),
+                      QuicTime::Delta::Zero(), QuicTime::Zero()),
+              windowed_max_bandwidth_(kMaxBandwidthWindowRounds, 0, 0)
     {
     }
 
@@ -66,6 +71,7 @@ namespace quic
         {
             min_rtt_ = send_delta;
         }
+        windowed_min_rtt_.Update(send_delta, now);
 
         QuicTime::Delta rtt_sample(send_delta);
         previous_srtt_ = smoothed_rtt_;
@@ -120,6 +126,17 @@ namespace quic
         smoothed_rtt_ = QuicTime::Delta::Zero();
         mean_deviation_ = QuicTime::Delta::Zero();
         initial_rtt_ = QuicTime::Delta::FromMilliseconds(kInitialRttMs);
+        windowed_min_rtt_.Clear();
+        windowed_max_bandwidth_.Clear();
+    }
+
+    void RttStats::UpdateMaxBandwidth(double bandwidth, uint64_t round)
+    {
+        if (bandwidth <= 0)
+        {
+            return;
+        }
+        windowed_max_bandwidth_.Update(bandwidth, round);
     }
 
     QuicTime::Delta RttStats::GetStandardOrMeanDeviation() const
@@ -169,6 +186,8 @@ namespace quic
         calculate_standard_deviation_ = stats.calculate_standard_deviation_;
         initial_rtt_ = stats.initial_rtt_;
         last_update_time_ = stats.last_update_time_;
+        windowed_min_rtt_ = stats.windowed_min_rtt_;
+        windowed_max_bandwidth_ = stats.windowed_max_bandwidth_;
     }
 
 }  // namespace quic
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cstdint>
 #include "quic_time.h"
+#include "windowed_filter.h"
 #include "basefw/base/log.h"
 /** RTT Sampler Modified from Chromium Quic implementation
  * using std::chrono::microsecond
@@ -122,6 +123,37 @@ namespace quic
             return min_rtt_;
         }
 
+        // Returns the min rtt over the last min rtt window, which ages out a
+        // propagation delay that no longer holds, e.g. after a route change.
+        // The window only moves with new samples.
+        // May return Zero if no valid updates have occurred.
+        QuicTime::Delta windowed_min_rtt() const
+        {
+            return windowed_min_rtt_.GetBest();
+        }
+
+        void set_min_rtt_window(QuicTime::Delta window)
+        {
+            windowed_min_rtt_.SetWindowLength(window);
+        }
+
+        // Feeds a delivery rate sample, in pieces per second, taken in round trip
+        // |round|. Rounds are counted by the caller.
+        void UpdateMaxBandwidth(double bandwidth, uint64_t round);
+
+        // Returns the max delivery rate over the last max bandwidth window rounds,
+        // in pieces per second.
+        // May return 0 if no valid updates have occurred.
+        double windowed_max_bandwidth() const
+        {
+            return windowed_max_bandwidth_.GetBest();
+        }
+
+        void set_max_bandwidth_window(uint64_t rounds)
+        {
+            windowed_max_bandwidth_.SetWindowLength(rounds);
+        }
+
         QuicTime::Delta mean_deviation() const
         {
             return mean_deviation_;
@@ -160,6 +192,10 @@ namespace quic
         bool calculate_standard_deviation_;
         QuicTime::Delta initial_rtt_;
         QuicTime last_update_time_;
+        // Min rtt over time, Kathleen Nichols' windowed filter.
+        WindowedFilter<QuicTime::Delta, MinFilter<QuicTime::Delta>, QuicTime, QuicTime::Delta> windowed_min_rtt_;
+        // Max delivery rate over round trips.
+        WindowedFilter<double, MaxFilter<double>, uint64_t, uint64_t> windowed_max_bandwidth_;
     };
 
 }  // namespace quic
@@ -0,0 +1,266 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "transporttime.h"
+
+/// A two level hashed timer wheel (Varghese & Lauck).
+/// Level 0 has one slot per tick, level 1 has one slot per level 0 revolution. Timers beyond the level 1 range
+/// are parked in its farthest slot and re-placed when that slot cascades.
+/// Schedule and Cancel are O(1), Advance only touches the slots that became due.
+/// A timer never fires before its deadline, and at most one granularity after it when Advance is called often enough.
+template <typename Payload>
+class TimerWheel
+{
+public:
+    using TimerId = uint64_t;/** node generation in the high 32 bits, node index in the low 32 bits*/
+    static constexpr TimerId kInvalidTimer = 0;
+
+    /// @param now the wheel starts turning from now
+    /// @param granularity length of one tick
+    explicit TimerWheel(Timepoint now, Duration granularity = Duration::FromMilliseconds(5))
+            : m_granularityUs(std::max<int64_t>(1, granularity.ToMicroseconds()))
+    {
+        m_curTick = TickFloor(now);
+        for (auto& head: m_heads)
+        {
+            head = kNil;
+        }
+    }
+
+    TimerId Schedule(Timepoint deadline, const Payload& payload)
+    {
+        uint64_t tick = TickCeil(deadline);
+        uint32_t idx = AllocNode();
+        auto& node = m_nodes[idx];
+        node.payload = payload;
+        node.tick = tick;
+        Link(idx);
+        ++m_size;
+        return (TimerId(node.gen) << 32) | idx;
+    }
+
+    /// @return false if the timer has fired or been cancelled already
+    bool Cancel(TimerId id)
+    {
+        uint32_t idx = static_cast<uint32_t>(id);
+        uint32_t gen = static_cast<uint32_t>(id >> 32);
+        if (id == kInvalidTimer || idx >= m_nodes.size() || m_nodes[idx].gen != gen || m_nodes[idx].list == kNoList)
+        {
+            return false;
+        }
+        Unlink(idx);
+        FreeNode(idx);
+        --m_size;
+        return true;
+    }
+
+    /// fire every timer whose deadline is not later than now, onExpired(const Payload&) may schedule or cancel
+    template <typename Fn>
+    void Advance(Timepoint now, Fn&& onExpired)
+    {
+        uint64_t nowTick = TickFloor(now);
+        while (m_curTick < nowTick && m_size > 0)
+        {
+            ++m_curTick;
+            if ((m_curTick & kL0Mask) == 0)
+            {
+                Cascade(kL0Slots + ((m_curTick >> kL0Bits) & kL1Mask));
+            }
+            FireSlot(m_curTick & kL0Mask, onExpired);
+        }
+        m_curTick = std::max(m_curTick, nowTick);
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    Duration Granularity() const
+    {
+        return Duration::FromMicroseconds(m_granularityUs);
+    }
+
+private:
+    static constexpr uint32_t kL0Bits = 8;
+    static constexpr uint32_t kL0Slots = 1U << kL0Bits;
+    static constexpr uint32_t kL0Mask = kL0Slots - 1;
+    static constexpr uint32_t kL1Slots = 64;
+    static constexpr uint32_t kL1Mask = kL1Slots - 1;
+    static constexpr uint32_t kNil = 0xFFFFFFFFU;
+    static constexpr uint16_t kNoList = 0xFFFFU;
+
+    struct Node
+    {
+        Payload payload;
+        uint64_t tick{ 0 };
+        uint32_t prev{ kNil };
+        uint32_t next{ kNil };
+        uint32_t gen{ 1 };
+        uint16_t list{ kNoList };
+    };
+
+    uint64_t TickFloor(Timepoint t) const
+    {
+        return static_cast<uint64_t>((t - Timepoint::Zero()).ToMicroseconds()) / m_granularityUs;
+    }
+
+    uint64_t TickCeil(Timepoint t) const
+    {
+        return (static_cast<uint64_t>((t - Timepoint::Zero()).ToMicroseconds()) + m_granularityUs - 1) /
+               m_granularityUs;
+    }
+
+    uint32_t AllocNode()
+    {
+        if (m_freeHead != kNil)
+        {
+            uint32_t idx = m_freeHead;
+            m_freeHead = m_nodes[idx].next;
+            return idx;
+        }
+        m_nodes.emplace_back();
+        return static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+
+    void FreeNode(uint32_t idx)
+    {
+        auto& node = m_nodes[idx];
+        node.payload = Payload();
+        node.list = kNoList;
+        node.prev = kNil;
+        ++node.gen;
+        if (node.gen == 0)
+        {
+            node.gen = 1;// keep ids non zero
+        }
+        node.next = m_freeHead;
+        m_freeHead = idx;
+    }
+
+    uint16_t ListOf(uint64_t tick) const
+    {
+        if (tick <= m_curTick)
+        {
+            // already due, fire on the next tick
+            return static_cast<uint16_t>((m_curTick + 1) & kL0Mask);
+        }
+        if (tick - m_curTick < kL0Slots)
+        {
+            return static_cast<uint16_t>(tick & kL0Mask);
+        }
+        uint64_t revs = (tick >> kL0Bits) - (m_curTick >> kL0Bits);
+        if (revs >= kL1Slots)
+        {
+            // too far, park in the farthest slot and re-place on cascade
+            revs = kL1Slots - 1;
+        }
+        return static_cast<uint16_t>(kL0Slots + (((m_curTick >> kL0Bits) + revs) & kL1Mask));
+    }
+
+    void Link(uint32_t idx)
+    {
+        LinkTo(idx, ListOf(m_nodes[idx].tick));
+    }
+
+    void LinkTo(uint32_t idx, uint16_t list)
+    {
+        auto& node = m_nodes[idx];
+        node.list = list;
+        node.prev = kNil;
+        node.next = m_heads[node.list];
+        if (node.next != kNil)
+        {
+            m_nodes[node.next].prev = idx;
+        }
+        m_heads[node.list] = idx;
+    }
+
+    void Unlink(uint32_t idx)
+    {
+        auto& node = m_nodes[idx];
+        if (node.prev != kNil)
+        {
+            m_nodes[node.prev].next = node.next;
+        }
+        else
+        {
+            m_heads[node.list] = node.next;
+        }
+        if (node.next != kNil)
+        {
+            m_nodes[node.next].prev = node.prev;
+        }
+        node.prev = kNil;
+        node.next = kNil;
+        node.list = kNoList;
+    }
+
+    /// move the timers of a level 1 slot down, or back into level 1 if still far away
+    /// those due at m_curTick go to its slot, fired right after the cascade instead of a tick late
+    void Cascade(uint32_t list)
+    {
+        uint32_t idx = m_heads[list];
+        m_heads[list] = kNil;
+        while (idx != kNil)
+        {
+            uint32_t next = m_nodes[idx].next;
+            if (m_nodes[idx].tick <= m_curTick)
+            {
+                LinkTo(idx, static_cast<uint16_t>(m_curTick & kL0Mask));
+            }
+            else
+            {
+                Link(idx);
+            }
+            idx = next;
+        }
+    }
+
+    template <typename Fn>
+    void FireSlot(uint32_t list, Fn&& onExpired)
+    {
+        // pop one by one, the callback may cancel other timers of this slot or schedule new ones
+        while (m_heads[list] != kNil)
+        {
+            uint32_t idx = m_heads[list];
+            Unlink(idx);
+            if (m_nodes[idx].tick > m_curTick)
+            {
+                Link(idx);
+                continue;
+            }
+            Payload payload = m_nodes[idx].payload;
+            FreeNode(idx);
+            --m_size;
+            onExpired(payload);
+        }
+    }
+
+    int64_t m_granularityUs;
+    uint64_t m_curTick{ 0 };/** the last tick that has been processed*/
+    size_t m_size{ 0 };
+    uint32_t m_heads[kL0Slots + kL1Slots];
+    std::vector<Node> m_nodes;
+    uint32_t m_freeHead{ kNil };
+};
+
+template <typename Payload>
+constexpr typename TimerWheel<Payload>::TimerId TimerWheel<Payload>::kInvalidTimer;
+template <typename Payload>
+constexpr uint32_t TimerWheel<Payload>::kL0Bits;
+template <typename Payload>
+constexpr uint32_t TimerWheel<Payload>::kL0Slots;
+template <typename Payload>
+constexpr uint32_t TimerWheel<Payload>::kL0Mask;
+template <typename Payload>
+constexpr uint32_t TimerWheel<Payload>::kL1Slots;
+template <typename Payload>
+constexpr uint32_t TimerWheel<Payload>::kL1Mask;
+template <typename Payload>
+constexpr uint32_t TimerWheel<Payload>::kNil;
+template <typename Payload>
+constexpr uint16_t TimerWheel<Payload>::kNoList;
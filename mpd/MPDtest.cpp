@@ -8,8 +8,35 @@
 #include "configjson.hpp"
 #include "demo/demotransportcontroller.hpp"
 #include "playerevent.h"
+#include <fstream>
 #include <iostream>
 
+/// forwards the play and cache position to the transport controller
+class DemoPlayerEventHandler : public PlayerEventHandler
+{
+public:
+    explicit DemoPlayerEventHandler(std::shared_ptr<PlayProgress> playProgress)
+            : m_playProgress(std::move(playProgress))
+    {
+    }
+
+    void OnPlayPosUpdate(uint64_t oldPlayPos, uint64_t newPlayPos) override
+    {
+        PlayerEventHandler::OnPlayPosUpdate(oldPlayPos, newPlayPos);
+        m_playProgress->playPos = newPlayPos;
+        m_playProgress->playing = true;
+    }
+
+    void OnPlayCacheUpdate(uint64_t oldCachePos, uint64_t newCachePos) override
+    {
+        PlayerEventHandler::OnPlayCacheUpdate(oldCachePos, newCachePos);
+        m_playProgress->cachePos = newCachePos;
+    }
+
+private:
+    std::shared_ptr<PlayProgress> m_playProgress;
+};
+
 
 int main(int argc, char** argv)
 {
@@ -45,7 +72,8 @@ int main(int argc, char** argv)
 
 
     ///////////////Create a Transport Module Setting///////////////
-    std::shared_ptr<TransportModuleSettings> myTransportModuleSettings = std::make_shared<TransportModuleSettings>();
+    // the demo settings run the loss detection alarm at the period of the DemoTransportCtlConfig
+    std::shared_ptr<TransportModuleSettings> myTransportModuleSettings = std::make_shared<DemoTransportModuleSettings>();
 
     // create your TransportCtlConfig class here. The parameters inside this class will be passed to
     // your TransportController.
@@ -53,7 +81,21 @@ int main(int argc, char** argv)
     std::shared_ptr<DemoTransportCtlConfig> myTransportCtlConfig = std::make_shared<DemoTransportCtlConfig>();
     // these values will be passed to demo transport module
     myTransportCtlConfig->minWnd = 1;
-    myTransportCtlConfig->maxWnd = 64;
+    myTransportCtlConfig->maxWnd = 1024;
+    // congestion control may be chosen in the json file, for all upside nodes or for each of them
+    std::ifstream jsonfile(jsonpath);
+    json downNodeJson = json::parse(jsonfile, nullptr, false);
+    if (downNodeJson.is_discarded() || !myTransportCtlConfig->ParseCongestionCtlJson(downNodeJson))
+    {
+        spdlog::error("Parse Congestion Control Config Failed. Exit");
+        return -1;
+    }
+    // so may the multipath scheduler
+    if (!myTransportCtlConfig->ParseMultiPathSchedulerJson(downNodeJson))
+    {
+        spdlog::error("Parse Multipath Scheduler Config Failed. Exit");
+        return -1;
+    }
 
     // Create your TransportCtlFactory
     std::shared_ptr<DemoTransportCtlFactory> myTransportFactory = std::make_shared<DemoTransportCtlFactory>();
@@ -65,14 +107,17 @@ int main(int argc, char** argv)
     /////////////////////////////// Now Set Up Dummy Player ///////////////
 
     // you may change or extend this class to receive player event
-    auto myPlayerEventHandler = std::make_shared<PlayerEventHandler>();
+    // the play progress is passed on to the transport controller, for deadline aware scheduling
+    PlayMetaConfig myPlayConfig;
+    myPlayConfig.filelengthinbyte = 10*1024*1024;
+    myTransportCtlConfig->playProgress = std::make_shared<PlayProgress>();
+    myTransportCtlConfig->playProgress->byterate = myPlayConfig.byterate;
+    auto myPlayerEventHandler = std::make_shared<DemoPlayerEventHandler>(myTransportCtlConfig->playProgress);
 
     /// step 1:
     MPD::CreatePlayer();
 
     ///step 2:
-    PlayMetaConfig myPlayConfig;
-    myPlayConfig.filelengthinbyte = 10*1024*1024;
     MPD::InitPlayer(myPlayConfig,MPD::SDKLogLevel::DEBUG,myPlayerEventHandler);
 
     ///step 3:
@@ -0,0 +1,111 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/** Cost of one loss detection alarm of DefaultLossDetectionAlgo, against a scan of the whole in-flight map.
+ *  Steady state with one expired packet per alarm: each alarm fires as the oldest packet in flight reaches its
+ *  loss delay, finds it lost, and it is replaced by a new packet.
+ *  usage: lossdetectbench [alarms per size]
+ * */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "mpd/download/transportcontroller/transportcontroller.hpp"
+#include "demo/sessionstreamcontroller.hpp"
+
+namespace
+{
+    const Duration kSendInterval = Duration::FromMicroseconds(10);
+
+    /// the alarm before DefaultLossDetectionAlgo walked the send order, every packet in flight is checked
+    void FullScanDetectLoss(const InFlightPacketMap& downloadingmap, Timepoint eventtime, Duration lossDelay,
+            LossEvent& losses)
+    {
+        for (const auto& seq_pkt: downloadingmap.inflightPktMap)
+        {
+            if (Timepoint(seq_pkt.second.sendtic + lossDelay) <= eventtime)
+            {
+                losses.lossPackets.emplace_back(seq_pkt.second);
+            }
+        }
+        if (!losses.lossPackets.empty())
+        {
+            losses.losttic = eventtime;
+            losses.valid = true;
+        }
+    }
+
+    /// @return nanoseconds per alarm
+    template <typename DetectFn>
+    double RunAlarms(uint32_t inflightCnt, uint32_t alarmCnt, DetectFn&& detect)
+    {
+        InFlightPacketMap downloadingmap;
+        RttStats rttstats;
+        Timepoint start = Timepoint::Zero() + Duration::FromSeconds(1);
+        rttstats.UpdateRtt(Duration::FromMilliseconds(40), Duration::Zero(), start);
+        Duration lossDelay = DefaultLossDetectionAlgo().GetLossDelay(rttstats);
+        SeqNumber seq = 0;
+        for (; seq < inflightCnt; ++seq)
+        {
+            DataPacket pkt;
+            pkt.seq = seq;
+            pkt.pieceId = static_cast<DataNumber>(seq);
+            downloadingmap.AddSentPacket(pkt, start + kSendInterval * static_cast<int>(seq));
+        }
+
+        uint64_t lostCnt = 0;
+        std::chrono::nanoseconds spent{ 0 };
+        for (uint32_t i = 0; i < alarmCnt; ++i)
+        {
+            // packet i, the oldest in flight, has just expired
+            Timepoint now = start + kSendInterval * static_cast<int>(i) + lossDelay;
+            LossEvent losses;
+            auto tic = std::chrono::steady_clock::now();
+            detect(downloadingmap, now, lossDelay, losses, rttstats);
+            spent += std::chrono::steady_clock::now() - tic;
+
+            lostCnt += losses.lossPackets.size();
+            for (auto&& lostpkt: losses.lossPackets)
+            {
+                downloadingmap.RemoveFromInFlight(lostpkt);
+            }
+            DataPacket pkt;
+            pkt.seq = seq;
+            pkt.pieceId = static_cast<DataNumber>(seq);
+            downloadingmap.AddSentPacket(pkt, start + kSendInterval * static_cast<int>(seq));
+            ++seq;
+        }
+        if (lostCnt != alarmCnt)
+        {
+            fprintf(stderr, "inflight %u: %lu lost in %u alarms, expected one per alarm\n", inflightCnt,
+                    static_cast<unsigned long>(lostCnt), alarmCnt);
+        }
+        return static_cast<double>(spent.count()) / alarmCnt;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t alarmCnt = argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 100000;
+    spdlog::set_level(spdlog::level::info);
+
+    DefaultLossDetectionAlgo algo;
+    AckEvent ack;
+    printf("%10s %16s %16s\n", "inflight", "send order ns", "full scan ns");
+    for (uint32_t inflightCnt: { 64U, 1000U, 10000U })
+    {
+        double sendOrderNs = RunAlarms(inflightCnt, alarmCnt,
+                [&](const InFlightPacketMap& downloadingmap, Timepoint now, Duration lossDelay, LossEvent& losses,
+                        RttStats& rttstats)
+                {
+                    algo.DetectLoss(downloadingmap, now, ack, MAX_SEQNUMBER, losses, rttstats);
+                });
+        double fullScanNs = RunAlarms(inflightCnt, alarmCnt,
+                [](const InFlightPacketMap& downloadingmap, Timepoint now, Duration lossDelay, LossEvent& losses,
+                        RttStats& rttstats)
+                {
+                    FullScanDetectLoss(downloadingmap, now, lossDelay, losses);
+                });
+        printf("%10u %16.1f %16.1f\n", inflightCnt, sendOrderNs, fullScanNs);
+    }
+    return 0;
+}